@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <mpi.h>
+
+/******************************************************************************
+ * This program performs the same search as LinearRegression.c, stepping from
+ * an initial estimate of m and c in 8 directions until none of them improves
+ * on the base, but it runs on any number of processes and splits the points
+ * between them instead of the directions.
+ *
+ * Rank 0 reads the points and scatters them, so each rank only holds its
+ * own share. Every iteration each rank sums the squared residuals of all 8
+ * estimates over its points, and a single MPI_Allreduce adds the 8 partial
+ * sums from every rank. All ranks then hold the same totals and make the
+ * same choice of the next base, so nothing else has to be sent.
+ *
+ * With the shared option the points are not scattered. Instead one copy of
+ * the whole data set is made on each node, in an MPI-3 shared memory window
+ * allocated by the first rank on the node. Rank 0 reads the points and
+ * broadcasts them to the first rank of every other node, and the other ranks
+ * on a node read their share straight out of the window without copying it.
+ * The memory used on a node is then the same however many ranks run there.
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00.
+ *
+ * To compile:
+ *   mpicc -o LinearRegressionAllreduce LinearRegressionAllreduce.c -lm
+ *
+ * To run on 4 processes, scattering the points or sharing them on each node:
+ *   mpirun -n 4 ./LinearRegressionAllreduce lr00_results.csv
+ *   mpirun -n 4 ./LinearRegressionAllreduce lr00_results.csv shared
+ *****************************************************************************/
+
+typedef struct point_t {
+  double x;
+  double y;
+} point_t;
+
+int n_data = 0;
+int n_local = 0;
+point_t *data;
+
+double residual_error(double x, double y, double m, double c) {
+  double e = (m * x) + c - y;
+  return e * e;
+}
+
+/**
+ Reads x,y lines from a file into data. Returns the number of points read,
+ or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = fopen(path, "r");
+  int capacity = 1024;
+  point_t p;
+
+  if(f == NULL) {
+    return -1;
+  }
+  data = malloc(sizeof(point_t) * capacity);
+  while(fscanf(f, " %lf , %lf", &p.x, &p.y) == 2) {
+    if(n_data == capacity) {
+      capacity *= 2;
+      data = realloc(data, sizeof(point_t) * capacity);
+    }
+    data[n_data++] = p;
+  }
+  fclose(f);
+  return n_data;
+}
+
+/**
+ Shares the points read by rank 0 out between all the ranks, as evenly as
+ possible. Each point is sent as two doubles.
+*/
+
+void scatter_data(int rank, int size) {
+  int *counts = malloc(sizeof(int) * size);
+  int *offsets = malloc(sizeof(int) * size);
+  point_t *local;
+  int i;
+
+  for(i=0; i<size; i++) {
+    offsets[i] = 2 * (int) ((long long) n_data * i / size);
+    counts[i] = 2 * (int) ((long long) n_data * (i + 1) / size) - offsets[i];
+  }
+  n_local = counts[rank] / 2;
+  local = malloc(sizeof(point_t) * (n_local > 0 ? n_local : 1));
+  MPI_Scatterv(data, counts, offsets, MPI_DOUBLE, local, counts[rank],
+               MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  if(rank == 0) {
+    free(data);
+  }
+  data = local;
+  free(counts);
+  free(offsets);
+}
+
+/**
+ Puts one copy of the points read by rank 0 on each node in a shared memory
+ window and points data at this rank's share of it. The window is returned
+ so that it can be freed at the end.
+*/
+
+MPI_Win share_data(int rank, int size) {
+  MPI_Comm node, leaders;
+  MPI_Win window;
+  MPI_Aint bytes;
+  point_t *shared;
+  int node_rank, disp_unit;
+  int start, end;
+
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank,
+                      MPI_INFO_NULL, &node);
+  MPI_Comm_rank(node, &node_rank);
+  MPI_Comm_split(MPI_COMM_WORLD, node_rank == 0 ? 0 : MPI_UNDEFINED, rank,
+                 &leaders);
+
+  bytes = node_rank == 0 ? (MPI_Aint) sizeof(point_t) * n_data : 0;
+  MPI_Win_allocate_shared(bytes, sizeof(point_t), MPI_INFO_NULL, node,
+                          &shared, &window);
+  MPI_Win_shared_query(window, 0, &bytes, &disp_unit, &shared);
+
+  if(node_rank == 0) {
+    if(rank == 0) {
+      memcpy(shared, data, sizeof(point_t) * n_data);
+      free(data);
+    }
+    MPI_Bcast(shared, 2 * n_data, MPI_DOUBLE, 0, leaders);
+    MPI_Comm_free(&leaders);
+  }
+  MPI_Barrier(node);
+  MPI_Comm_free(&node);
+
+  start = (long long) n_data * rank / size;
+  end = (long long) n_data * (rank + 1) / size;
+  data = shared + start;
+  n_local = end - start;
+  return window;
+}
+
+/**
+ Adds the squared residuals of n estimates over this rank's points, then
+ totals them over every rank. The rms errors are left in e.
+*/
+
+void rms_errors(double *m, double *c, double *e, int n) {
+  double sums[8] = {0};
+  int i, j;
+
+  for(i=0; i<n_local; i++) {
+    for(j=0; j<n; j++) {
+      sums[j] += residual_error(data[i].x, data[i].y, m[j], c[j]);
+    }
+  }
+  MPI_Allreduce(sums, e, n, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  for(j=0; j<n; j++) {
+    e[j] = sqrt(e[j] / n_data);
+  }
+}
+
+int timedifference(struct timespec *start, struct timespec *finish, long long int *difference) {
+   long long int dsec = finish->tv_sec - start->tv_sec;
+   long long int dnsec = finish->tv_nsec - start->tv_nsec;
+
+	if(dnsec < 0) {
+		dsec--;
+		dnsec += 1000000000;
+	}
+
+   *difference = dsec * 1000000000 + dnsec;
+   return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+
+  struct timespec start, finish;
+  long long int timeelapsed;
+
+  int rank, size;
+  int i;
+  double bm = 1.3;
+  double bc = 10;
+  double be;
+  double dm[8];
+  double dc[8];
+  double e[8];
+  double step = 0.01;
+  double best_error = 999999999;
+  int best_error_i = 0;
+  int minimum_found = 0;
+  int use_shared = 0;
+  MPI_Win window;
+
+  double om[] = {0,1,1, 1, 0,-1,-1,-1};
+  double oc[] = {1,1,0,-1,-1,-1, 0, 1};
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  if(argc == 3 && strcmp(argv[2], "shared") == 0) {
+    use_shared = 1;
+  } else if(argc != 2) {
+    if(rank == 0) {
+      fprintf(stderr, "usage: %s data.csv [shared]\n", argv[0]);
+    }
+    MPI_Finalize();
+    return 1;
+  }
+  if(rank == 0 && load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    n_data = 0;
+  }
+  MPI_Bcast(&n_data, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if(n_data <= 0) {
+    MPI_Finalize();
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if(use_shared) {
+    window = share_data(rank, size);
+  } else {
+    scatter_data(rank, size);
+  }
+
+  rms_errors(&bm, &bc, &be, 1);
+
+  while(!minimum_found) {
+    for(i=0;i<8;i++) {
+      dm[i] = bm + (om[i] * step);
+      dc[i] = bc + (oc[i] * step);
+    }
+
+    rms_errors(dm, dc, e, 8);
+    for(i=0;i<8;i++) {
+      if(e[i] < best_error) {
+        best_error = e[i];
+        best_error_i = i;
+      }
+    }
+
+    if(best_error < be) {
+      be = best_error;
+      bm = dm[best_error_i];
+      bc = dc[best_error_i];
+    } else {
+      minimum_found = 1;
+    }
+  }
+
+  if(rank == 0) {
+    printf("minimum m,c is %lf,%lf with error %lf\n", bm, bc, be);
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    timedifference(&start, &finish, &timeelapsed);
+    printf("Time elapsed was %lldns or %0.9lfs\n", timeelapsed,
+           (timeelapsed/1.0e9));
+  }
+
+  if(use_shared) {
+    MPI_Win_free(&window);
+  }
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,683 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <crypt.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sched.h>
+
+/******************************************************************************
+  A threaded version of CrackAZ99-With-Data.c with tunable parameters. It
+  cracks the same kind of password, 3 uppercase letters and a 2 digit
+  integer, using a single sweep of the keyspace that checks every password.
+
+  The keyspace is handed out to the threads in chunks. Each thread formats
+  a batch of candidates into a local buffer and then hashes them, checking
+  whether it should stop between batches. The best values for the number of
+  threads, the chunk size and the batch width depend on the machine and on
+  the hash type, so there is an auto-tune mode. It runs short timed trials
+  over the parameter space and saves the fastest configuration to a profile
+  for this host and hash type:
+
+    $HOME/.CrackAZ99-<hostname>-<hash type>.profile
+
+  Later runs load that profile automatically. Parameters given on the command
+  line override the profile.
+
+  Threads can be pinned to CPUs with a placement policy:
+    none     leave placement to the operating system
+    compact  fill every hardware thread of a core, then the next core, then
+             the next socket
+    scatter  spread threads over the sockets and cores first, and only use
+             the second hardware thread of a core once every core has one
+    core     one thread per physical core, spread over the sockets, never
+             sharing a core's SHA-512 execution units with a sibling
+  Each thread pins itself before allocating its candidate batch and crypt
+  buffers, so with first-touch page placement they come from its own NUMA
+  node. The hash rate of every thread is printed at the end so that the
+  per-core rate can be compared between thread counts.
+
+  Compile with:
+    cc -o CrackAZ99-Tuned CrackAZ99-Tuned.c -lcrypt -pthread
+
+  To tune this host, using 1 second per trial, and then crack:
+    ./CrackAZ99-Tuned -T 1
+    ./CrackAZ99-Tuned
+
+  To crack with explicit parameters:
+    ./CrackAZ99-Tuned -t 8 -c 256 -b 16 -p core
+******************************************************************************/
+
+#define DEFAULT_CHUNK 64
+#define DEFAULT_BATCH 8
+#define MAX_BATCH 1024
+#define MAX_THREADS 1024
+#define MAX_CPUS 1024
+#define MAX_NODES 64
+
+#define POLICY_NONE 0
+#define POLICY_COMPACT 1
+#define POLICY_SCATTER 2
+#define POLICY_CORE 3
+
+char *policy_names[] = {"none", "compact", "scatter", "core"};
+
+int n_passwords = 4;
+
+char *encrypted_passwords[] = {
+  "$6$KB$UE9sg8u7cP9yh3ORqxHTSSrZ1wvMBSOtd/OxPUvutk5/GZ4qC0AltwXOriV9Cz/NysJj6GI//TVL/9G0U4dpW.",
+  "$6$KB$GSJvSzTyFUUl2mPpo4AIDsWy81FCcazkxDasWfFoAuOSRsgT2d8/VKBex9k1BZgEoDwM.FdErrjoSnAssBIoj0",
+  "$6$KB$MCp2sCzujTTZybX1rkcaW5Fz5cfOhu0GfSLk/hbwWtzU835ddUagNQ0Jmq9BYpusCP.N34KBfdMm13n8MnHBw/",
+  "$6$KB$pgXJO0tr54wjce0bcMvQMHEllvi0vbMlyYI7liEdaZTE6Mwg/Eglk0PJxhQEDJ0bbOkg0J1/XSRliAmA6gTUT0"
+};
+
+typedef struct config_t {
+  int threads;
+  int chunk;
+  int batch;
+  int policy;
+} config_t;
+
+typedef struct cpu_t {
+  int id;
+  int package;     // The socket
+  int core;        // The physical core within the socket
+  int sibling;     // Which hardware thread of the core this is
+  int node;        // The NUMA node
+} cpu_t;
+
+cpu_t cpus[MAX_CPUS];
+int n_cpus = 0;
+
+/**
+ State shared by the threads of one run, either a real crack or a trial.
+*/
+
+typedef struct sweep_t {
+  config_t config;
+  int n_candidates;          // The end of the part of the keyspace to sweep
+  int next;                  // The first candidate not yet handed out
+  int explored;              // The number of candidates hashed so far
+  int n_found;               // found and n_found are written under lock,
+  int *found;                // and read without it by atomic loads
+  int report;                // 1 to print matches
+  struct timespec deadline;  // Trials stop handing out chunks after this
+  int timed;
+  pthread_mutex_t lock;
+} sweep_t;
+
+/**
+ The arguments of one thread, and what it measured.
+*/
+
+typedef struct worker_t {
+  sweep_t *sweep;
+  int cpu;                   // The CPU to pin to, or -1
+  int node;                  // The NUMA node of that CPU
+  int explored;
+  double seconds;
+} worker_t;
+
+int n_candidates = 26 * 26 * 26 * 100;
+
+int time_difference(struct timespec *start,
+                    struct timespec *finish,
+                    long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+/**
+ Candidate number n, in the same order as the nested loops of crack() in
+ CrackAZ99-With-Data.c.
+*/
+
+void candidate(int n, char *plain) {
+  sprintf(plain, "%c%c%c%02d", 'A' + (n / 100 / 26 / 26) % 26,
+          'A' + (n / 100 / 26) % 26, 'A' + (n / 100) % 26, n % 100);
+}
+
+/**
+ The salt of an encrypted password is everything up to the last $.
+*/
+
+void salt_of(char *salt_and_encrypted, char *salt) {
+  char *end = strrchr(salt_and_encrypted, '$');
+  int length = end ? end - salt_and_encrypted + 1 : 0;
+
+  memcpy(salt, salt_and_encrypted, length);
+  salt[length] = '\0';
+}
+
+const char *hash_type(char *salt_and_encrypted) {
+  if(strncmp(salt_and_encrypted, "$6$", 3) == 0) {
+    return "sha512";
+  } else if(strncmp(salt_and_encrypted, "$5$", 3) == 0) {
+    return "sha256";
+  } else if(strncmp(salt_and_encrypted, "$1$", 3) == 0) {
+    return "md5";
+  }
+  return "des";
+}
+
+int read_topology(int cpu, char *name) {
+  char path[256];
+  int value = -1;
+  FILE *f;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s",
+           cpu, name);
+  f = fopen(path, "r");
+  if(f == NULL) {
+    return -1;
+  }
+  if(fscanf(f, "%d", &value) != 1) {
+    value = -1;
+  }
+  fclose(f);
+  return value;
+}
+
+/**
+ Finds the CPUs this process may run on and where they are in the machine.
+ Where sysfs does not say, each CPU is treated as its own core on socket 0.
+*/
+
+void discover_topology() {
+  cpu_set_t allowed;
+  char path[256];
+  int cpu, node, j;
+
+  n_cpus = 0;
+  if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return;
+  }
+  for(cpu=0; cpu<CPU_SETSIZE && n_cpus<MAX_CPUS; cpu++) {
+    cpu_t *c = &cpus[n_cpus];
+    if(!CPU_ISSET(cpu, &allowed)) {
+      continue;
+    }
+    c->id = cpu;
+    c->package = read_topology(cpu, "physical_package_id");
+    c->core = read_topology(cpu, "core_id");
+    if(c->package < 0 || c->core < 0) {
+      c->package = 0;
+      c->core = cpu;
+    }
+    c->node = 0;
+    for(node=0; node<MAX_NODES; node++) {
+      snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%d",
+               cpu, node);
+      if(access(path, F_OK) == 0) {
+        c->node = node;
+        break;
+      }
+    }
+    c->sibling = 0;
+    for(j=0; j<n_cpus; j++) {
+      if(cpus[j].package == c->package && cpus[j].core == c->core) {
+        c->sibling++;
+      }
+    }
+    n_cpus++;
+  }
+}
+
+int compare_compact(const void *a, const void *b) {
+  const cpu_t *x = a, *y = b;
+
+  if(x->package != y->package) {
+    return x->package - y->package;
+  }
+  if(x->core != y->core) {
+    return x->core - y->core;
+  }
+  return x->sibling - y->sibling;
+}
+
+int compare_scatter(const void *a, const void *b) {
+  const cpu_t *x = a, *y = b;
+
+  if(x->sibling != y->sibling) {
+    return x->sibling - y->sibling;
+  }
+  if(x->core != y->core) {
+    return x->core - y->core;
+  }
+  return x->package - y->package;
+}
+
+/**
+ Puts the CPUs that a policy uses into order, in the order threads are placed
+ on them. Returns how many there are; thread i goes on order[i % count].
+*/
+
+int placement(int policy, cpu_t *order) {
+  int i, count = 0;
+
+  for(i=0; i<n_cpus; i++) {
+    if(policy != POLICY_CORE || cpus[i].sibling == 0) {
+      order[count++] = cpus[i];
+    }
+  }
+  qsort(order, count, sizeof(cpu_t), policy == POLICY_COMPACT ?
+        compare_compact : compare_scatter);
+  return count;
+}
+
+int parse_policy(char *name) {
+  int i;
+
+  for(i=0; i<(int) (sizeof(policy_names)/sizeof(policy_names[0])); i++) {
+    if(strcmp(name, policy_names[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ Takes the next chunk of the keyspace, returning 0 when there is none left.
+*/
+
+int next_chunk(sweep_t *sweep, int *first, int *last) {
+  struct timespec now;
+  long long int remaining;
+  int more = 0;
+
+  pthread_mutex_lock(&sweep->lock);
+  if(sweep->timed) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(time_difference(&now, &sweep->deadline, &remaining)) {
+      pthread_mutex_unlock(&sweep->lock);
+      return 0;
+    }
+  }
+  if(sweep->next < sweep->n_candidates && sweep->n_found < n_passwords) {
+    *first = sweep->next;
+    sweep->next += sweep->config.chunk;
+    if(sweep->next > sweep->n_candidates) {
+      sweep->next = sweep->n_candidates;
+    }
+    *last = sweep->next;
+    more = 1;
+  }
+  pthread_mutex_unlock(&sweep->lock);
+  return more;
+}
+
+void *crack_thread(void *args) {
+  worker_t *worker = args;
+  sweep_t *sweep = worker->sweep;
+  struct crypt_data *cdata;
+  char (*plain)[8];
+  char salt[64], last_salt[64];
+  char *enc;
+  int first, last, n, b, i, count;
+  struct timespec start, finish;
+  long long int time_elapsed;
+  cpu_set_t cpu;
+
+  if(worker->cpu >= 0) {
+    CPU_ZERO(&cpu);
+    CPU_SET(worker->cpu, &cpu);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu), &cpu);
+  }
+  cdata = calloc(1, sizeof(struct crypt_data));
+  plain = calloc(sweep->config.batch, sizeof(*plain));
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while(next_chunk(sweep, &first, &last)) {
+    for(n=first; n<last &&
+        __atomic_load_n(&sweep->n_found, __ATOMIC_ACQUIRE) < n_passwords;
+        n+=count) {
+      count = last - n < sweep->config.batch ? last - n : sweep->config.batch;
+      for(b=0; b<count; b++) {
+        candidate(n + b, plain[b]);
+      }
+      for(b=0; b<count; b++) {
+        enc = NULL;
+        last_salt[0] = '\0';
+        for(i=0; i<n_passwords; i++) {
+          if(__atomic_load_n(&sweep->found[i], __ATOMIC_ACQUIRE)) {
+            continue;
+          }
+          salt_of(encrypted_passwords[i], salt);
+          if(enc == NULL || strcmp(salt, last_salt) != 0) {
+            enc = crypt_r(plain[b], salt, cdata);
+            strcpy(last_salt, salt);
+          }
+          if(enc != NULL && strcmp(encrypted_passwords[i], enc) == 0) {
+            pthread_mutex_lock(&sweep->lock);
+            if(!sweep->found[i]) {
+              __atomic_store_n(&sweep->found[i], 1, __ATOMIC_RELEASE);
+              __atomic_add_fetch(&sweep->n_found, 1, __ATOMIC_RELEASE);
+              if(sweep->report) {
+                printf("#%-8d%s %s\n", n + b + 1, plain[b], enc);
+              }
+            }
+            pthread_mutex_unlock(&sweep->lock);
+          }
+        }
+      }
+      pthread_mutex_lock(&sweep->lock);
+      sweep->explored += count;
+      pthread_mutex_unlock(&sweep->lock);
+      worker->explored += count;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  worker->seconds = time_elapsed/1.0e9;
+  free(plain);
+  free(cdata);
+  return NULL;
+}
+
+/**
+ Sweeps the keyspace with the given configuration. If seconds is greater
+ than zero the sweep is a trial that stops handing out work after that many
+ seconds. Returns the number of candidates hashed per second.
+*/
+
+double sweep_keyspace(config_t config, double seconds, int report) {
+  sweep_t sweep;
+  pthread_t threads[MAX_THREADS];
+  worker_t workers[MAX_THREADS];
+  cpu_t order[MAX_CPUS];
+  struct timespec start, finish;
+  long long int time_elapsed;
+  double per_thread = 0;
+  int i, n_places = 0;
+
+  memset(&sweep, 0, sizeof(sweep));
+  sweep.config = config;
+  sweep.n_candidates = n_candidates;
+  sweep.found = calloc(n_passwords, sizeof(int));
+  sweep.report = report;
+  pthread_mutex_init(&sweep.lock, NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if(seconds > 0) {
+    sweep.timed = 1;
+    sweep.deadline = start;
+    sweep.deadline.tv_sec += (long) seconds;
+    sweep.deadline.tv_nsec += (long) ((seconds - (long) seconds) * 1e9);
+    if(sweep.deadline.tv_nsec >= 1000000000) {
+      sweep.deadline.tv_sec++;
+      sweep.deadline.tv_nsec -= 1000000000;
+    }
+  }
+  if(config.policy != POLICY_NONE) {
+    n_places = placement(config.policy, order);
+  }
+  for(i=0; i<config.threads; i++) {
+    workers[i].sweep = &sweep;
+    workers[i].cpu = n_places > 0 ? order[i % n_places].id : -1;
+    workers[i].node = n_places > 0 ? order[i % n_places].node : -1;
+    workers[i].explored = 0;
+    workers[i].seconds = 0;
+    pthread_create(&threads[i], NULL, crack_thread, &workers[i]);
+  }
+  for(i=0; i<config.threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+
+  if(report) {
+    for(i=0; i<config.threads; i++) {
+      double rate = workers[i].seconds > 0 ?
+                    workers[i].explored / workers[i].seconds : 0;
+      printf("thread %d on cpu %d node %d: %d candidates, %0.1lf hashes/s\n",
+             i, workers[i].cpu, workers[i].node, workers[i].explored, rate);
+      per_thread += rate;
+    }
+    printf("mean per-thread rate %0.1lf hashes/s with policy %s\n",
+           per_thread / config.threads, policy_names[config.policy]);
+    if(n_places > 0 && config.threads > n_places) {
+      printf("more threads than CPUs for policy %s, some share a CPU\n",
+             policy_names[config.policy]);
+    }
+    printf("%d solutions explored\n", sweep.explored);
+  }
+  pthread_mutex_destroy(&sweep.lock);
+  free(sweep.found);
+  return sweep.explored / (time_elapsed/1.0e9);
+}
+
+void profile_path(char *path, int size) {
+  char host[256];
+  const char *home = getenv("HOME");
+
+  if(gethostname(host, sizeof(host)) != 0) {
+    strcpy(host, "localhost");
+  }
+  host[sizeof(host) - 1] = '\0';
+  snprintf(path, size, "%s/.CrackAZ99-%s-%s.profile", home ? home : ".", host,
+           hash_type(encrypted_passwords[0]));
+}
+
+/**
+ Fills in config from the profile of this host. Returns 1 if there was one.
+*/
+
+int load_profile(config_t *config) {
+  char path[1024], key[32], text[32];
+  int value, loaded = 0;
+  FILE *f;
+
+  profile_path(path, sizeof(path));
+  f = fopen(path, "r");
+  if(f == NULL) {
+    return 0;
+  }
+  while(fscanf(f, "%31s %31s", key, text) == 2) {
+    if(strcmp(key, "policy") == 0 && parse_policy(text) >= 0) {
+      config->policy = parse_policy(text);
+      loaded = 1;
+      continue;
+    }
+    value = atoi(text);
+    if(value <= 0) {
+      continue;
+    }
+    if(strcmp(key, "threads") == 0 && value <= MAX_THREADS) {
+      config->threads = value;
+      loaded = 1;
+    } else if(strcmp(key, "chunk") == 0) {
+      config->chunk = value;
+      loaded = 1;
+    } else if(strcmp(key, "batch") == 0 && value <= MAX_BATCH) {
+      config->batch = value;
+      loaded = 1;
+    }
+  }
+  fclose(f);
+  return loaded;
+}
+
+int save_profile(config_t *config, double rate) {
+  char path[1024];
+  FILE *f;
+
+  profile_path(path, sizeof(path));
+  f = fopen(path, "w");
+  if(f == NULL) {
+    perror(path);
+    return 1;
+  }
+  fprintf(f, "threads %d\nchunk %d\nbatch %d\npolicy %s\n", config->threads,
+          config->chunk, config->batch, policy_names[config->policy]);
+  fprintf(f, "# %0.1lf hashes/s\n", rate);
+  fclose(f);
+  printf("profile saved to %s\n", path);
+  return 0;
+}
+
+double trial(config_t config, double seconds) {
+  double rate = sweep_keyspace(config, seconds, 0);
+
+  printf("trial threads %4d chunk %5d batch %4d policy %-7s: "
+         "%0.1lf hashes/s\n", config.threads, config.chunk, config.batch,
+         policy_names[config.policy], rate);
+  fflush(stdout);
+  return rate;
+}
+
+/**
+ Searches the parameter space one parameter at a time: the thread count
+ first, as it matters most, then the chunk size, the batch width and the
+ placement policy, each time keeping the best values found so far. A full
+ grid would take far longer for little benefit.
+*/
+
+int tune(double seconds) {
+  int n_online = sysconf(_SC_NPROCESSORS_ONLN);
+  int chunks[] = {1, 4, 16, 64, 256, 1024};
+  int batches[] = {1, 2, 4, 8, 16, 64};
+  config_t best = {1, DEFAULT_CHUNK, DEFAULT_BATCH, POLICY_NONE};
+  config_t config;
+  double best_rate, rate;
+  int i, t;
+
+  if(n_online < 1) {
+    n_online = 1;
+  }
+  best_rate = trial(best, seconds);
+  config = best;
+  for(t=2; t<=2*n_online && t<=MAX_THREADS; t*=2) {
+    config.threads = t;
+    rate = trial(config, seconds);
+    if(rate > best_rate) {
+      best_rate = rate;
+      best = config;
+    }
+  }
+  if(n_online != best.threads && n_online <= MAX_THREADS) {
+    config = best;
+    config.threads = n_online;
+    rate = trial(config, seconds);
+    if(rate > best_rate) {
+      best_rate = rate;
+      best = config;
+    }
+  }
+
+  for(i=0; i<(int) (sizeof(chunks)/sizeof(chunks[0])); i++) {
+    config = best;
+    config.chunk = chunks[i];
+    if(config.chunk == best.chunk) {
+      continue;
+    }
+    rate = trial(config, seconds);
+    if(rate > best_rate) {
+      best_rate = rate;
+      best = config;
+    }
+  }
+
+  for(i=0; i<(int) (sizeof(batches)/sizeof(batches[0])); i++) {
+    config = best;
+    config.batch = batches[i];
+    if(config.batch == best.batch || config.batch > best.chunk) {
+      continue;
+    }
+    rate = trial(config, seconds);
+    if(rate > best_rate) {
+      best_rate = rate;
+      best = config;
+    }
+  }
+
+  for(i=POLICY_COMPACT; i<=POLICY_CORE && n_cpus>1; i++) {
+    config = best;
+    config.policy = i;
+    rate = trial(config, seconds);
+    if(rate > best_rate) {
+      best_rate = rate;
+      best = config;
+    }
+  }
+
+  printf("best threads %d chunk %d batch %d policy %s: %0.1lf hashes/s\n",
+         best.threads, best.chunk, best.batch, policy_names[best.policy],
+         best_rate);
+  return save_profile(&best, best_rate);
+}
+
+int main(int argc, char *argv[]){
+  struct timespec start, finish;
+  long long int time_elapsed;
+  config_t config = {1, DEFAULT_CHUNK, DEFAULT_BATCH, POLICY_NONE};
+  config_t given = {0, 0, 0, -1};
+  double tune_seconds = 0;
+  int opt;
+
+  config.threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if(config.threads < 1) {
+    config.threads = 1;
+  }
+  if(config.threads > MAX_THREADS) {
+    config.threads = MAX_THREADS;
+  }
+  discover_topology();
+  while((opt = getopt(argc, argv, "t:c:b:p:T:")) != -1) {
+    switch(opt) {
+    case 't': given.threads = atoi(optarg); break;
+    case 'c': given.chunk = atoi(optarg); break;
+    case 'b': given.batch = atoi(optarg); break;
+    case 'p':
+      given.policy = parse_policy(optarg);
+      if(given.policy < 0) {
+        fprintf(stderr, "policy must be none, compact, scatter or core\n");
+        return 1;
+      }
+      break;
+    case 'T': tune_seconds = atof(optarg); break;
+    default:
+      fprintf(stderr, "usage: %s [-t threads] [-c chunk] [-b batch] "
+              "[-p policy] [-T seconds per tuning trial]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if(tune_seconds > 0) {
+    return tune(tune_seconds);
+  }
+
+  if(load_profile(&config)) {
+    printf("using profile threads %d chunk %d batch %d policy %s\n",
+           config.threads, config.chunk, config.batch,
+           policy_names[config.policy]);
+  }
+  if(given.threads > 0) {
+    config.threads = given.threads < MAX_THREADS ? given.threads : MAX_THREADS;
+  }
+  if(given.chunk > 0) {
+    config.chunk = given.chunk;
+  }
+  if(given.batch > 0) {
+    config.batch = given.batch < MAX_BATCH ? given.batch : MAX_BATCH;
+  }
+  if(given.policy >= 0) {
+    config.policy = given.policy;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  sweep_keyspace(config, 0, 1);
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+                                         (time_elapsed/1.0e9));
+  return 0;
+}
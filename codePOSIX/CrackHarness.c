@@ -0,0 +1,477 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <crypt.h>
+#include <time.h>
+#include <unistd.h>
+
+/******************************************************************************
+  A correctness and performance regression harness for the password crackers
+  in this repository:
+
+    codePOSIX/CrackAZ99-With-Data.c     3 letters, 2 digits, libcrypt
+    codePOSIX/CrackAZ99-Tuned.c         3 letters, 2 digits, libcrypt, threads
+    codeMPI/Password2Digit.c            2 letters, 2 digits, libcrypt, 3 ranks
+    codeMPI/Password4Digit.c            2 letters, 4 digits, libcrypt, 3 ranks
+    codeCUDA/cuda_crack.cu              2 letters, 4 digits, plain text
+    codeCUDA/Passwordcracking2digit.cu  2 letters, 2 digits, plain text
+
+  For every engine a synthetic challenge set of 4 random passwords from the
+  engine's keyspace is generated. They are encrypted the same way as
+  EncryptSHA512.c does it and written over the engine's hard coded
+  encrypted_passwords[] (the CUDA engines compare plain text, so their
+  passwords in is_a_match() are replaced instead). The patched copy is
+  compiled in a temporary directory and run, and the passwords it reports are
+  checked against the expected set: every password must be found and nothing
+  else may be reported.
+
+  The number of candidates tried per second is recorded for each engine. When
+  a baseline file exists, an engine whose rate falls more than the tolerance
+  below its baseline fails. Engines whose compiler is not installed are
+  skipped.
+
+  Compile with:
+    cc -o CrackHarness CrackHarness.c -lcrypt
+
+  To run every available engine from this directory:
+    ./CrackHarness
+
+  To run one engine, record its rate as the new baseline, or change the
+  tolerance to 5%:
+    ./CrackHarness CrackAZ99
+    ./CrackHarness -u
+    ./CrackHarness -t 0.05
+
+  Options:
+    -r dir   repository root, default ..
+    -b file  baseline file, default CrackHarness.baseline
+    -t tol   allowed fractional drop in hashes/sec, default 0.10
+    -s seed  seed for the challenge passwords, default 1
+    -u       write the measured rates to the baseline file
+    -k       keep the temporary directory
+
+  MPI engines are started with "mpirun -n 3", which can be overridden with
+  the MPIRUN environment variable.
+
+  The exit status is 0 only if every engine that ran passed.
+******************************************************************************/
+
+#define SALT "$6$KB$"
+#define N_CHALLENGES 4
+#define MAX_ENGINES 8
+#define MAX_LINE 4096
+
+typedef struct engine_t {
+  char *name;
+  char *source;
+  char *compiler;
+  char *libs;
+  int mpi;
+  int letters;
+  int digits;
+  int plain_text;     // 1 if the engine compares plain text, not hashes
+} engine_t;
+
+engine_t engines[] = {
+  {"CrackAZ99", "codePOSIX/CrackAZ99-With-Data.c", "cc", "-lcrypt",
+   0, 3, 2, 0},
+  {"CrackAZ99-Tuned", "codePOSIX/CrackAZ99-Tuned.c", "cc", "-lcrypt -pthread",
+   0, 3, 2, 0},
+  {"Password2Digit", "codeMPI/Password2Digit.c", "mpicc", "-lrt -lcrypt",
+   1, 2, 2, 0},
+  {"Password4Digit", "codeMPI/Password4Digit.c", "mpicc", "-lrt -lcrypt",
+   1, 2, 4, 0},
+  {"cuda_crack", "codeCUDA/cuda_crack.cu", "nvcc", "-lcrypt",
+   0, 2, 4, 1},
+  {"Passwordcracking2digit", "codeCUDA/Passwordcracking2digit.cu", "nvcc", "",
+   0, 2, 2, 1}
+};
+
+int n_engines = sizeof(engines) / sizeof(engines[0]);
+
+int time_difference(struct timespec *start,
+                    struct timespec *finish,
+                    long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+long long keyspace(engine_t *engine) {
+  long long n = 1;
+  int i;
+
+  for(i=0; i<engine->letters; i++) {
+    n *= 26;
+  }
+  for(i=0; i<engine->digits; i++) {
+    n *= 10;
+  }
+  return n;
+}
+
+/**
+ Generates distinct random passwords in the keyspace of an engine.
+*/
+
+void make_challenges(engine_t *engine, unsigned int seed,
+                     char plain[][16]) {
+  int i, j, k;
+
+  srand(seed);
+  for(i=0; i<N_CHALLENGES; i++) {
+    do {
+      for(j=0; j<engine->letters; j++) {
+        plain[i][j] = 'A' + rand() % 26;
+      }
+      for(k=0; k<engine->digits; k++) {
+        plain[i][j + k] = '0' + rand() % 10;
+      }
+      plain[i][j + k] = '\0';
+      for(j=0; j<i; j++) {
+        if(strcmp(plain[i], plain[j]) == 0) {
+          break;
+        }
+      }
+    } while(j < i);
+  }
+}
+
+char *read_file(char *path) {
+  FILE *f = fopen(path, "r");
+  char *text;
+  long size;
+
+  if(f == NULL) {
+    return NULL;
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  rewind(f);
+  text = malloc(size + 1);
+  if(fread(text, 1, size, f) != (size_t) size) {
+    free(text);
+    fclose(f);
+    return NULL;
+  }
+  text[size] = '\0';
+  fclose(f);
+  return text;
+}
+
+/**
+ Writes a copy of an engine's source with the challenges substituted for its
+ own passwords. Returns 0 on success.
+*/
+
+int write_patched_source(engine_t *engine, char *text, char plain[][16],
+                         char *path) {
+  FILE *out = fopen(path, "w");
+  char *p = text;
+  char *start, *end;
+  int i;
+
+  if(out == NULL) {
+    return 1;
+  }
+  if(!engine->plain_text) {
+    start = strstr(p, "encrypted_passwords[] = {");
+    end = start ? strstr(start, "};") : NULL;
+    if(end == NULL) {
+      fclose(out);
+      return 1;
+    }
+    start = strchr(start, '{') + 1;
+    fwrite(p, 1, start - p, out);
+    for(i=0; i<N_CHALLENGES; i++) {
+      fprintf(out, "\n  \"%s\"%s", crypt(plain[i], SALT),
+              i < N_CHALLENGES - 1 ? "," : "\n");
+    }
+    fputs(end, out);
+  } else {
+    // The first N_CHALLENGES string initialisers inside is_a_match()
+    p = strstr(text, "is_a_match");
+    if(p == NULL) {
+      fclose(out);
+      return 1;
+    }
+    fwrite(text, 1, p - text, out);
+    for(i=0; i<N_CHALLENGES; i++) {
+      start = strstr(p, "[] = \"");
+      end = start ? strchr(start + 6, '"') : NULL;
+      if(end == NULL) {
+        fclose(out);
+        return 1;
+      }
+      start += 6;
+      fwrite(p, 1, start - p, out);
+      fputs(plain[i], out);
+      p = end;
+    }
+    fputs(p, out);
+  }
+  fclose(out);
+  return 0;
+}
+
+/**
+ Pulls a reported password out of a line of engine output, or returns 0 if
+ the line does not report one. The libcrypt engines mark a match with a #
+ followed by the candidate count; the CUDA engines print "Found password: ",
+ and "Password: " is accepted as well.
+*/
+
+int parse_found(char *line, char *found) {
+  char *p;
+
+  if(line[0] == '#') {
+    return sscanf(line + 1, "%*d%15s", found) == 1;
+  }
+  p = strstr(line, "Found password: ");
+  if(p != NULL) {
+    return sscanf(p + 16, "%15s", found) == 1;
+  }
+  p = strstr(line, "Password: ");
+  if(p != NULL) {
+    return sscanf(p + 10, "%15s", found) == 1;
+  }
+  return 0;
+}
+
+double baseline_rate(char *path, char *name) {
+  FILE *f = fopen(path, "r");
+  char line[MAX_LINE], engine[256];
+  double rate, result = 0;
+
+  if(f == NULL) {
+    return 0;
+  }
+  while(fgets(line, sizeof(line), f) != NULL) {
+    if(sscanf(line, "%255s %lf", engine, &rate) == 2 &&
+       strcmp(engine, name) == 0) {
+      result = rate;
+    }
+  }
+  fclose(f);
+  return result;
+}
+
+int compiler_available(char *compiler) {
+  char command[MAX_LINE];
+
+  snprintf(command, sizeof(command), "command -v %s > /dev/null 2>&1",
+           compiler);
+  return system(command) == 0;
+}
+
+/**
+ Runs one engine. Returns 0 if it passed, 1 if it failed and -1 if it was
+ skipped. The measured rate is stored in *rate.
+*/
+
+int run_engine(engine_t *engine, char *root, char *dir, unsigned int seed,
+               char *baseline, double tolerance, double *rate) {
+  char plain[N_CHALLENGES][16];
+  char found[16];
+  int matched[N_CHALLENGES];
+  char path[MAX_LINE], source[MAX_LINE], command[3 * MAX_LINE];
+  char line[MAX_LINE];
+  char *text, *mpirun, *ext;
+  struct timespec start, finish;
+  long long int time_elapsed, explored = 0, n;
+  int i, failed = 0, extra = 0;
+  double base;
+  FILE *run;
+
+  *rate = 0;
+  if(!compiler_available(engine->compiler)) {
+    printf("SKIP %s: %s not found\n", engine->name, engine->compiler);
+    return -1;
+  }
+  snprintf(path, sizeof(path), "%s/%s", root, engine->source);
+  text = read_file(path);
+  if(text == NULL) {
+    printf("FAIL %s: cannot read %s\n", engine->name, path);
+    return 1;
+  }
+
+  make_challenges(engine, seed, plain);
+  ext = strrchr(engine->source, '.');
+  snprintf(source, sizeof(source), "%s/%s%s", dir, engine->name, ext);
+  if(write_patched_source(engine, text, plain, source) != 0) {
+    printf("FAIL %s: cannot find the passwords in %s\n", engine->name, path);
+    free(text);
+    return 1;
+  }
+  free(text);
+
+  snprintf(command, sizeof(command), "%s -o %s/%s %s %s > %s/%s.build 2>&1",
+           engine->compiler, dir, engine->name, source, engine->libs, dir,
+           engine->name);
+  if(system(command) != 0) {
+    printf("FAIL %s: build failed, see %s/%s.build\n", engine->name, dir,
+           engine->name);
+    return 1;
+  }
+
+  mpirun = getenv("MPIRUN");
+  snprintf(command, sizeof(command), "%s %s/%s", engine->mpi ?
+           (mpirun ? mpirun : "mpirun -n 3") : "", dir, engine->name);
+  memset(matched, 0, sizeof(matched));
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  run = popen(command, "r");
+  if(run == NULL) {
+    printf("FAIL %s: cannot run %s\n", engine->name, command);
+    return 1;
+  }
+  while(fgets(line, sizeof(line), run) != NULL) {
+    if(strstr(line, "solutions explored") != NULL &&
+       sscanf(line, "%lld", &n) == 1) {
+      explored += n;
+    }
+    if(!parse_found(line, found)) {
+      continue;
+    }
+    for(i=0; i<N_CHALLENGES; i++) {
+      if(strcmp(found, plain[i]) == 0) {
+        matched[i]++;
+        break;
+      }
+    }
+    if(i == N_CHALLENGES) {
+      printf("     %s reported %s, which is not a challenge\n", engine->name,
+             found);
+      extra++;
+    }
+  }
+  if(pclose(run) != 0) {
+    printf("     %s exited with an error\n", engine->name);
+    failed = 1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+
+  for(i=0; i<N_CHALLENGES; i++) {
+    if(matched[i] != 1) {
+      printf("     %s found %s %d times, expected once\n", engine->name,
+             plain[i], matched[i]);
+      failed = 1;
+    }
+  }
+  if(extra) {
+    failed = 1;
+  }
+
+  // Engines that do not report their count sweep the keyspace once
+  if(explored == 0) {
+    explored = keyspace(engine);
+  }
+  *rate = explored / (time_elapsed/1.0e9);
+  base = baseline_rate(baseline, engine->name);
+  printf("%s %s: %lld candidates in %0.9lfs, %0.1lf hashes/s", failed ?
+         "FAIL" : "PASS", engine->name, explored, time_elapsed/1.0e9, *rate);
+  if(base > 0) {
+    printf(", baseline %0.1lf (%+0.1lf%%)", base, 100.0 * (*rate - base) / base);
+    if(*rate < base * (1 - tolerance)) {
+      printf(" slower than the %0.0lf%% tolerance", 100 * tolerance);
+      failed = 1;
+    }
+  }
+  printf("\n");
+  return failed;
+}
+
+int main(int argc, char *argv[]){
+  char *root = "..";
+  char *baseline = "CrackHarness.baseline";
+  double tolerance = 0.10;
+  unsigned int seed = 1;
+  int update = 0, keep = 0;
+  double rates[MAX_ENGINES];
+  int results[MAX_ENGINES];
+  int selected = 0;
+  char dir[] = "/tmp/CrackHarnessXXXXXX";
+  char command[MAX_LINE];
+  int opt, i, j, failures = 0;
+  FILE *f;
+
+  while((opt = getopt(argc, argv, "r:b:t:s:uk")) != -1) {
+    switch(opt) {
+    case 'r': root = optarg; break;
+    case 'b': baseline = optarg; break;
+    case 't': tolerance = atof(optarg); break;
+    case 's': seed = atoi(optarg); break;
+    case 'u': update = 1; break;
+    case 'k': keep = 1; break;
+    default:
+      fprintf(stderr, "usage: %s [-r dir] [-b file] [-t tol] [-s seed] [-u] "
+              "[-k] [engine...]\n", argv[0]);
+      return 2;
+    }
+  }
+  if(mkdtemp(dir) == NULL) {
+    perror(dir);
+    return 2;
+  }
+
+  for(i=0; i<n_engines; i++) {
+    results[i] = -1;
+    rates[i] = 0;
+    if(optind < argc) {
+      for(j=optind; j<argc; j++) {
+        if(strcmp(argv[j], engines[i].name) == 0) {
+          break;
+        }
+      }
+      if(j == argc) {
+        continue;
+      }
+    }
+    selected++;
+    results[i] = run_engine(&engines[i], root, dir, seed + i, baseline,
+                            tolerance, &rates[i]);
+    if(results[i] == 1) {
+      failures++;
+    }
+  }
+  if(selected == 0) {
+    fprintf(stderr, "no engine matches the names given\n");
+    return 2;
+  }
+
+  if(update) {
+    // Engines that were not run keep their old baseline
+    for(i=0; i<n_engines; i++) {
+      if(results[i] != 0) {
+        rates[i] = baseline_rate(baseline, engines[i].name);
+      }
+    }
+    f = fopen(baseline, "w");
+    if(f == NULL) {
+      perror(baseline);
+      return 2;
+    }
+    for(i=0; i<n_engines; i++) {
+      if(rates[i] > 0) {
+        fprintf(f, "%s %0.1lf\n", engines[i].name, rates[i]);
+      }
+    }
+    fclose(f);
+    printf("baseline written to %s\n", baseline);
+  }
+
+  if(keep) {
+    printf("temporary files kept in %s\n", dir);
+  } else {
+    snprintf(command, sizeof(command), "rm -rf %s", dir);
+    system(command);
+  }
+  printf("%d engine%s failed\n", failures, failures == 1 ? "" : "s");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,580 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <crypt.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/******************************************************************************
+  A long running cracking scheduler. Instead of starting one CrackAZ99 style
+  program per hash list, each of which assumes it owns the whole machine,
+  jobs are submitted to this process over a Unix socket. The keyspace of
+  every job is cut into chunks and the chunks of all the jobs are interleaved
+  on one shared pool of worker threads.
+
+  Every job has a priority and a fair-share weight. Workers always take the
+  next chunk from the highest priority job that still has work. Between jobs
+  of the same priority the chunks are shared out in proportion to the weights,
+  by always serving the job that has received the least work per unit of
+  weight so far.
+
+  A job is a file holding one encrypted password per line, together with the
+  shape of the passwords: a number of uppercase letters followed by a number
+  of digits, e.g. 3 letters and 2 digits for CrackAZ99-With-Data.c.
+
+  Compile with:
+    cc -o CrackScheduler CrackScheduler.c -lcrypt -pthread
+
+  Start the scheduler with 4 worker threads:
+    ./CrackScheduler serve 4 &
+
+  Submit a job called az99, priority 1, weight 2, passwords like ABC12:
+    ./CrackScheduler submit az99 1 2 3 2 hashes.txt
+
+  Show the progress of every job, or stop the scheduler:
+    ./CrackScheduler status
+    ./CrackScheduler shutdown
+
+  Check the keyspace enumeration, including letters-only jobs, without a
+  server:
+    ./CrackScheduler check
+
+  The socket defaults to /tmp/CrackScheduler.sock and can be changed by
+  setting CRACK_SOCKET in the environment of both the server and the client.
+******************************************************************************/
+
+#define SOCKET_PATH "/tmp/CrackScheduler.sock"
+#define MAX_JOBS 64
+#define MAX_HASHES 256
+#define MAX_LINE 4096
+#define CHUNK_SIZE 64
+
+typedef struct job_t {
+  int id;
+  char name[64];
+  int priority;
+  double weight;
+  int letters;
+  int digits;
+  int n_hashes;
+  char *hashes[MAX_HASHES];
+  char *found[MAX_HASHES];
+  int n_found;
+  long long total;       // The number of candidates in the keyspace
+  long long next;        // The first candidate not yet handed to a worker
+  long long done;        // The number of candidates checked so far
+  int in_flight;         // The number of chunks currently being checked
+  double vtime;          // Candidates served divided by weight
+  int finished;
+  struct timespec submitted;
+  struct timespec completed;
+} job_t;
+
+job_t *jobs[MAX_JOBS];
+int n_jobs = 0;
+int shutting_down = 0;
+pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t work_available = PTHREAD_COND_INITIALIZER;
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                    long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+const char *socket_path() {
+  const char *path = getenv("CRACK_SOCKET");
+  return path ? path : SOCKET_PATH;
+}
+
+/**
+ Writes candidate number index of the keyspace into plain. The candidates are
+ ordered the same way as the nested loops of crack(), so the letters are the
+ most significant part and the digits are printed with leading zeros.
+*/
+
+void candidate(job_t *job, long long index, char *plain) {
+  int i;
+  long long digit_space = 1;
+
+  for(i=0; i<job->digits; i++) {
+    digit_space *= 10;
+  }
+  if(job->digits > 0) {
+    sprintf(plain + job->letters, "%0*lld", job->digits, index % digit_space);
+  } else {
+    plain[job->letters] = '\0';
+  }
+  index /= digit_space;
+  for(i=job->letters-1; i>=0; i--) {
+    plain[i] = 'A' + (index % 26);
+    index /= 26;
+  }
+}
+
+int job_runnable(job_t *job) {
+  return !job->finished && job->next < job->total;
+}
+
+/**
+ Chooses the job that the next chunk is taken from. Must be called with the
+ lock held. Returns NULL when there is nothing to do.
+*/
+
+job_t *pick_job() {
+  int i;
+  job_t *best = NULL;
+
+  for(i=0; i<n_jobs; i++) {
+    job_t *job = jobs[i];
+    if(!job_runnable(job)) {
+      continue;
+    }
+    if(best == NULL || job->priority > best->priority ||
+       (job->priority == best->priority && job->vtime < best->vtime)) {
+      best = job;
+    }
+  }
+  return best;
+}
+
+/**
+ A job that arrives late starts level with the jobs already running at its
+ priority, otherwise it would hold every worker until it had caught up.
+*/
+
+double starting_vtime(int priority) {
+  int i;
+  int any = 0;
+  double vtime = 0;
+
+  for(i=0; i<n_jobs; i++) {
+    if(job_runnable(jobs[i]) && jobs[i]->priority == priority) {
+      if(!any || jobs[i]->vtime < vtime) {
+        vtime = jobs[i]->vtime;
+      }
+      any = 1;
+    }
+  }
+  return vtime;
+}
+
+void finish_job(job_t *job) {
+  long long int time_elapsed;
+
+  job->finished = 1;
+  clock_gettime(CLOCK_MONOTONIC, &job->completed);
+  time_difference(&job->submitted, &job->completed, &time_elapsed);
+  printf("job %d %s finished, %d of %d found, %lld solutions explored in "
+         "%0.9lfs\n", job->id, job->name, job->n_found, job->n_hashes,
+         job->done, time_elapsed/1.0e9);
+  fflush(stdout);
+}
+
+/**
+ Checks candidates first to first+count-1 of a job. Hashes that share a salt
+ with the previous hash reuse its result, so a list that was all produced by
+ EncryptSHA512 costs one crypt per candidate. Other workers set found under
+ the lock, so it is read here with an atomic load rather than taking it.
+*/
+
+void crack_chunk(job_t *job, long long first, long long count,
+                 struct crypt_data *cdata) {
+  long long n;
+  int h;
+  char plain[32];
+  char salt[MAX_LINE];
+  char last_salt[MAX_LINE];
+  char *enc;
+
+  for(n=first; n<first+count; n++) {
+    candidate(job, n, plain);
+    last_salt[0] = '\0';
+    enc = NULL;
+    for(h=0; h<job->n_hashes; h++) {
+      char *hash = job->hashes[h];
+      char *end;
+      if(__atomic_load_n(&job->found[h], __ATOMIC_ACQUIRE) != NULL) {
+        continue;
+      }
+      end = strrchr(hash, '$');
+      if(end == NULL) {
+        continue;
+      }
+      memcpy(salt, hash, end - hash + 1);
+      salt[end - hash + 1] = '\0';
+      if(enc == NULL || strcmp(salt, last_salt) != 0) {
+        enc = crypt_r(plain, salt, cdata);
+        strcpy(last_salt, salt);
+      }
+      if(enc != NULL && strcmp(hash, enc) == 0) {
+        pthread_mutex_lock(&lock);
+        if(job->found[h] == NULL) {
+          __atomic_store_n(&job->found[h], strdup(plain), __ATOMIC_RELEASE);
+          job->n_found++;
+          printf("#job %d %s %s %s\n", job->id, job->name, plain, hash);
+          fflush(stdout);
+        }
+        pthread_mutex_unlock(&lock);
+      }
+    }
+  }
+}
+
+void *worker(void *args) {
+  struct crypt_data *cdata = calloc(1, sizeof(struct crypt_data));
+
+  (void) args;
+  pthread_mutex_lock(&lock);
+  while(!shutting_down) {
+    job_t *job = pick_job();
+    long long first, count;
+
+    if(job == NULL) {
+      pthread_cond_wait(&work_available, &lock);
+      continue;
+    }
+    first = job->next;
+    count = job->total - first < CHUNK_SIZE ? job->total - first : CHUNK_SIZE;
+    job->next += count;
+    job->vtime += count / job->weight;
+    job->in_flight++;
+    pthread_mutex_unlock(&lock);
+
+    crack_chunk(job, first, count, cdata);
+
+    pthread_mutex_lock(&lock);
+    job->in_flight--;
+    job->done += count;
+    if(!job->finished && (job->n_found == job->n_hashes ||
+       (job->next >= job->total && job->in_flight == 0))) {
+      finish_job(job);
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  free(cdata);
+  return NULL;
+}
+
+/**
+ Reads a job from a hash list file. Returns an error message, or NULL if the
+ job was added.
+*/
+
+const char *add_job(char *name, int priority, double weight, int letters,
+                    int digits, char *path, int *id) {
+  FILE *f;
+  char line[MAX_LINE];
+  job_t *job;
+  long long total = 1;
+  int i;
+
+  if(letters < 0 || digits < 0 || letters + digits == 0 ||
+     letters + digits > 16 || weight <= 0) {
+    return "bad keyspace or weight";
+  }
+  for(i=0; i<letters; i++) {
+    if(total > LLONG_MAX / 26) {
+      return "keyspace too large";
+    }
+    total *= 26;
+  }
+  for(i=0; i<digits; i++) {
+    if(total > LLONG_MAX / 10) {
+      return "keyspace too large";
+    }
+    total *= 10;
+  }
+  f = fopen(path, "r");
+  if(f == NULL) {
+    return "cannot open hash list";
+  }
+  job = calloc(1, sizeof(job_t));
+  strncpy(job->name, name, sizeof(job->name) - 1);
+  job->priority = priority;
+  job->weight = weight;
+  job->letters = letters;
+  job->digits = digits;
+  while(job->n_hashes < MAX_HASHES && fgets(line, sizeof(line), f) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if(line[0] != '\0') {
+      job->hashes[job->n_hashes++] = strdup(line);
+    }
+  }
+  fclose(f);
+  if(job->n_hashes == 0) {
+    free(job);
+    return "hash list is empty";
+  }
+  job->total = total;
+  clock_gettime(CLOCK_MONOTONIC, &job->submitted);
+
+  pthread_mutex_lock(&lock);
+  if(n_jobs == MAX_JOBS) {
+    pthread_mutex_unlock(&lock);
+    for(i=0; i<job->n_hashes; i++) {
+      free(job->hashes[i]);
+    }
+    free(job);
+    return "too many jobs";
+  }
+  job->id = n_jobs + 1;
+  job->vtime = starting_vtime(priority);
+  jobs[n_jobs++] = job;
+  *id = job->id;
+  pthread_cond_broadcast(&work_available);
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+void write_status(FILE *out) {
+  int i, h;
+  struct timespec now;
+  long long int time_elapsed;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  pthread_mutex_lock(&lock);
+  for(i=0; i<n_jobs; i++) {
+    job_t *job = jobs[i];
+    time_difference(&job->submitted, job->finished ? &job->completed : &now,
+                    &time_elapsed);
+    fprintf(out, "job %d %s priority %d weight %g %s %lld/%lld %0.1lf%% "
+            "found %d/%d %0.1lf hashes/s\n", job->id, job->name,
+            job->priority, job->weight, job->finished ? "done" : "running",
+            job->done, job->total, 100.0 * job->done / job->total,
+            job->n_found, job->n_hashes,
+            time_elapsed > 0 ? job->done / (time_elapsed/1.0e9) : 0.0);
+    for(h=0; h<job->n_hashes; h++) {
+      if(job->found[h] != NULL) {
+        fprintf(out, "#%s %s\n", job->found[h], job->hashes[h]);
+      }
+    }
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+/**
+ Handles one client connection. Each connection carries a single command:
+   SUBMIT name priority weight letters digits path
+   STATUS
+   SHUTDOWN
+*/
+
+void serve_client(int fd) {
+  FILE *in = fdopen(fd, "r+");
+  char line[MAX_LINE];
+  char name[64], path[MAX_LINE];
+  int priority, letters, digits, id;
+  double weight;
+
+  if(in == NULL) {
+    close(fd);
+    return;
+  }
+  if(fgets(line, sizeof(line), in) == NULL) {
+    fclose(in);
+    return;
+  }
+  if(sscanf(line, "SUBMIT %63s %d %lf %d %d %4095s", name, &priority, &weight,
+            &letters, &digits, path) == 6) {
+    const char *error = add_job(name, priority, weight, letters, digits, path,
+                                &id);
+    if(error) {
+      fprintf(in, "error %s\n", error);
+    } else {
+      fprintf(in, "job %d submitted\n", id);
+    }
+  } else if(strncmp(line, "STATUS", 6) == 0) {
+    write_status(in);
+  } else if(strncmp(line, "SHUTDOWN", 8) == 0) {
+    pthread_mutex_lock(&lock);
+    shutting_down = 1;
+    pthread_cond_broadcast(&work_available);
+    pthread_mutex_unlock(&lock);
+    fprintf(in, "shutting down\n");
+  } else {
+    fprintf(in, "error unknown command\n");
+  }
+  fclose(in);
+}
+
+int serve(int n_threads) {
+  struct sockaddr_un addr;
+  pthread_t *threads;
+  int listen_fd, i;
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(listen_fd < 0) {
+    perror("socket");
+    return 1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path(), sizeof(addr.sun_path) - 1);
+  unlink(addr.sun_path);
+  if(bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+     listen(listen_fd, 16) < 0) {
+    perror(addr.sun_path);
+    return 1;
+  }
+
+  threads = malloc(sizeof(pthread_t) * n_threads);
+  for(i=0; i<n_threads; i++) {
+    pthread_create(&threads[i], NULL, worker, NULL);
+  }
+  printf("scheduler listening on %s with %d workers\n", addr.sun_path,
+         n_threads);
+  fflush(stdout);
+
+  while(!shutting_down) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if(fd >= 0) {
+      serve_client(fd);
+    }
+  }
+
+  for(i=0; i<n_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  close(listen_fd);
+  unlink(addr.sun_path);
+  free(threads);
+  return 0;
+}
+
+/**
+ Sends one command line to the scheduler and copies the reply to stdout.
+*/
+
+int send_command(const char *command) {
+  struct sockaddr_un addr;
+  char line[MAX_LINE];
+  FILE *conn;
+  int fd;
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path(), sizeof(addr.sun_path) - 1);
+  if(fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+    perror(addr.sun_path);
+    return 1;
+  }
+  conn = fdopen(fd, "r+");
+  fprintf(conn, "%s\n", command);
+  fflush(conn);
+  while(fgets(line, sizeof(line), conn) != NULL) {
+    fputs(line, stdout);
+    if(strncmp(line, "error", 5) == 0) {
+      fclose(conn);
+      return 1;
+    }
+  }
+  fclose(conn);
+  return 0;
+}
+
+/**
+ Checks the first and last candidates of a few job shapes, including ones
+ with no letters or no digits, and cracks a letters-only hash with
+ crack_chunk(). Returns the number of checks that failed.
+*/
+
+int self_test(void) {
+  int shapes[][2] = {{3, 2}, {2, 0}, {0, 3}, {4, 0}};
+  char *firsts[] = {"AAA00", "AA", "000", "AAAA"};
+  char *lasts[] = {"ZZZ99", "ZZ", "999", "ZZZZ"};
+  struct crypt_data *cdata = calloc(1, sizeof(struct crypt_data));
+  job_t *job = calloc(1, sizeof(job_t));
+  char plain[32];
+  char *enc;
+  int failures = 0, s, i;
+
+  for(s=0; s<4; s++) {
+    job->letters = shapes[s][0];
+    job->digits = shapes[s][1];
+    job->total = 1;
+    for(i=0; i<job->letters; i++) {
+      job->total *= 26;
+    }
+    for(i=0; i<job->digits; i++) {
+      job->total *= 10;
+    }
+    candidate(job, 0, plain);
+    if(strcmp(plain, firsts[s]) != 0) {
+      printf("FAIL %d letters %d digits: first candidate %s, not %s\n",
+             job->letters, job->digits, plain, firsts[s]);
+      failures++;
+    }
+    candidate(job, job->total - 1, plain);
+    if(strcmp(plain, lasts[s]) != 0) {
+      printf("FAIL %d letters %d digits: last candidate %s, not %s\n",
+             job->letters, job->digits, plain, lasts[s]);
+      failures++;
+    }
+  }
+
+  strcpy(job->name, "letters");
+  job->letters = 2;
+  job->digits = 0;
+  job->total = 26 * 26;
+  enc = crypt_r("QZ", "$6$KB$", cdata);
+  job->hashes[0] = strdup(enc);
+  job->n_hashes = 1;
+  crack_chunk(job, 0, job->total, cdata);
+  if(job->found[0] == NULL || strcmp(job->found[0], "QZ") != 0) {
+    printf("FAIL letters-only job did not find QZ\n");
+    failures++;
+  }
+  printf("%s\n", failures == 0 ? "all checks passed" : "checks failed");
+  free(job->hashes[0]);
+  free(job->found[0]);
+  free(job);
+  free(cdata);
+  return failures;
+}
+
+int main(int argc, char *argv[]){
+  char command[MAX_LINE + 256];
+  char path[PATH_MAX];
+
+  if(argc >= 2 && strcmp(argv[1], "serve") == 0) {
+    int n_threads = argc >= 3 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+    return serve(n_threads > 0 ? n_threads : 1);
+  }
+  if(argc == 8 && strcmp(argv[1], "submit") == 0) {
+    if(realpath(argv[7], path) == NULL) {
+      perror(argv[7]);
+      return 1;
+    }
+    snprintf(command, sizeof(command), "SUBMIT %s %s %s %s %s %s", argv[2],
+             argv[3], argv[4], argv[5], argv[6], path);
+    return send_command(command);
+  }
+  if(argc == 2 && strcmp(argv[1], "status") == 0) {
+    return send_command("STATUS");
+  }
+  if(argc == 2 && strcmp(argv[1], "shutdown") == 0) {
+    return send_command("SHUTDOWN");
+  }
+  if(argc == 2 && strcmp(argv[1], "check") == 0) {
+    return self_test() == 0 ? 0 : 1;
+  }
+  fprintf(stderr, "usage: %s serve [threads]\n"
+          "       %s submit name priority weight letters digits hashfile\n"
+          "       %s status\n"
+          "       %s shutdown\n"
+          "       %s check\n", argv[0], argv[0], argv[0], argv[0], argv[0]);
+  return 1;
+}
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/******************************************************************************
+ * This program searches for m and c in the same 8 directions as 118.c, but
+ * the step is not fixed at 0.01. After a move that improves on the base the
+ * step is multiplied by STEP_GROW, so the search crosses long flat stretches
+ * of the error surface in a few moves. When none of the 8 directions
+ * improves on the base the step is multiplied by STEP_SHRINK and the
+ * neighbourhood is tried again, closer in. The search ends once the step
+ * falls below the tolerance, so the answer is as precise as the tolerance
+ * asks for rather than a multiple of 0.01.
+ *
+ * From (1.3, 10) on the lr00 data 118.c takes over 2400 iterations, each a
+ * full pass over the data for every direction. With a tolerance of 0.01 this
+ * search stops at the same point after about 110 iterations, and with the
+ * default tolerance it stops in under 450 within 2e-6 of the least squares
+ * m and 1e-4 of its c. The minimum lies in a long, narrow valley running
+ * diagonally to the 8 directions, which is what keeps the count from falling
+ * further. The error barely changes along the valley, so the step falling
+ * below the tolerance does not put m and c that close to the minimum; a
+ * tolerance of 1e-9 gets c to within 2e-6 in under 600 iterations.
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00.
+ *
+ * To compile:
+ *   cc -O2 -o lr_adaptive lr_adaptive.c -lm
+ *
+ * To run to the default tolerance, to 0.01, or to 1e-9 starting with a step
+ * of 1:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_adaptive lr00_results.csv
+ *   ./lr_adaptive lr00_results.csv 0.01
+ *   ./lr_adaptive lr00_results.csv 1e-9 1
+ *****************************************************************************/
+
+#define STEP_GROW 2.0
+#define STEP_SHRINK 0.5
+#define TOLERANCE 1e-6
+
+typedef struct point_t {
+  double x;
+  double y;
+} point_t;
+
+int n_data = 0;
+point_t *data;
+
+/**
+ Reads x,y lines from a file, or from stdin if the path is "-". Returns the
+ number of points read, or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  point_t p;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  data = malloc(sizeof(point_t) * capacity);
+  while(fscanf(f, " %lf , %lf", &p.x, &p.y) == 2) {
+    if(n_data == capacity) {
+      capacity *= 2;
+      data = realloc(data, sizeof(point_t) * capacity);
+    }
+    data[n_data++] = p;
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+  return n_data;
+}
+
+double residual_error(double x, double y, double m, double c) {
+  double e = (m * x) + c - y;
+  return e * e;
+}
+
+double rms_error(double m, double c) {
+  int i;
+  double mean;
+  double error_sum = 0;
+
+  for(i=0; i<n_data; i++) {
+    error_sum += residual_error(data[i].x, data[i].y, m, c);
+  }
+
+  mean = error_sum / n_data;
+
+  return sqrt(mean);
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  int i;
+  double bm = 1.3;
+  double bc = 10;
+  double be;
+  double dm[8];
+  double dc[8];
+  double e[8];
+  double step = 0.01;
+  double tolerance = TOLERANCE;
+  double best_error;
+  int best_error_i;
+  int iterations = 0;
+
+  double om[] = {0,1,1, 1, 0,-1,-1,-1};
+  double oc[] = {1,1,0,-1,-1,-1, 0, 1};
+
+  if(argc < 2 || argc > 4) {
+    fprintf(stderr, "usage: %s data.csv [tolerance] [initial step]\n",
+            argv[0]);
+    return 1;
+  }
+  if(argc >= 3) {
+    sscanf(argv[2], "%lf", &tolerance);
+  }
+  if(argc == 4) {
+    sscanf(argv[3], "%lf", &step);
+  }
+  if(!(tolerance > 0) || !(step > 0)) {
+    fprintf(stderr, "the tolerance and the step must be positive\n");
+    return 1;
+  }
+  if(load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  be = rms_error(bm, bc);
+
+  while(step >= tolerance) {
+    for(i=0;i<8;i++) {
+      dm[i] = bm + (om[i] * step);
+      dc[i] = bc + (oc[i] * step);
+    }
+
+    best_error = be;
+    best_error_i = -1;
+    for(i=0;i<8;i++) {
+      e[i] = rms_error(dm[i], dc[i]);
+      if(e[i] < best_error) {
+        best_error = e[i];
+        best_error_i = i;
+      }
+    }
+    iterations++;
+
+    if(best_error_i >= 0) {
+      printf("best m,c is %lf,%lf with error %lf in direction %d, step %g\n",
+        dm[best_error_i], dc[best_error_i], best_error, best_error_i, step);
+      be = best_error;
+      bm = dm[best_error_i];
+      bc = dc[best_error_i];
+      step *= STEP_GROW;
+    } else {
+      step *= STEP_SHRINK;
+    }
+  }
+  printf("minimum m,c is %0.9lf,%0.9lf with error %0.9lf\n", bm, bc, be);
+  printf("%d iterations, %d evaluations of the error\n", iterations,
+         8 * iterations + 1);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+/******************************************************************************
+ * This program fits a separate line y = mx + c to each of many series in
+ * one run, instead of running 118.c once per series. The input is a file of
+ * series,x,y lines, where series is any name without a comma, and the lines
+ * of a series need not be together. The output is a line per series, in the
+ * order the series first appear:
+ *
+ *   series,m,c,rms error,points
+ *
+ * Each fit is the exact least squares line, m = Sxy / Sxx and
+ * c = mean_y - m mean_x, with the rms error from Sxx, Sxy and Syy, the same
+ * closed form as lr_sums.c. Unlike lr_sums.c, which keeps the deviations
+ * from the means, this program gathers the plain sums of x, y, x^2, xy and
+ * y^2 in one pass over the points of the series and forms the deviations
+ * from them at the end, as the plain sums vectorise across series. That is
+ * only accurate because the points are first shifted, as described below. A
+ * series of one point, or whose x values are all the same, has no slope, and
+ * its m, c and error are written as nan.
+ *
+ * Most series are short, so fitting them one at a time would leave the
+ * vector units idle. Instead the series are sorted by length and taken
+ * LANES at a time. The points of the LANES series are interleaved into one
+ * buffer, point i of series j at i * LANES + j, and the shorter series are
+ * padded with zeros, so the inner loop adds LANES independent sums with the
+ * same instruction and vectorises. Before packing, the first point of each
+ * series is subtracted from all its points, which keeps the sums small and
+ * makes the zero padding contribute nothing.
+ *
+ * The groups of series are handed to the threads one at a time from a
+ * shared counter, so threads that get short series take more of them.
+ *
+ * To compile:
+ *   cc -O3 -o lr_batch lr_batch.c -lm -pthread
+ *
+ * To fit every series in a file with 4 threads, writing the fits to a file:
+ *   ./lr_batch series.csv 4 fits.csv
+ *****************************************************************************/
+
+#define MAX_THREADS 256
+#define LANES 8
+
+typedef struct series_t {
+  char *name;
+  int start;
+  int n;
+  double m;
+  double c;
+  double error;
+} series_t;
+
+int n_data = 0;
+double *xs, *ys;
+int *series_of;
+
+int n_series = 0;
+series_t *series;
+int *by_length;
+int n_groups;
+int next_group = 0;
+pthread_mutex_t group_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** An open addressing table from series names to series numbers. */
+int *name_table;
+int name_table_size = 1024;
+
+unsigned long hash_name(char *name) {
+  unsigned long h = 14695981039346656037UL;
+
+  while(*name) {
+    h = (h ^ (unsigned char) *name++) * 1099511628211UL;
+  }
+  return h;
+}
+
+/**
+ Returns the number of the named series, adding it if it is new.
+*/
+
+int find_series(char *name) {
+  unsigned long slot;
+  int i, *old_table, old_size;
+
+  if(2 * n_series >= name_table_size) {
+    old_table = name_table;
+    old_size = name_table_size;
+    name_table_size *= 2;
+    name_table = malloc(sizeof(int) * name_table_size);
+    memset(name_table, -1, sizeof(int) * name_table_size);
+    for(i=0; i<old_size; i++) {
+      if(old_table[i] >= 0) {
+        slot = hash_name(series[old_table[i]].name) & (name_table_size - 1);
+        while(name_table[slot] >= 0) {
+          slot = (slot + 1) & (name_table_size - 1);
+        }
+        name_table[slot] = old_table[i];
+      }
+    }
+    free(old_table);
+  }
+
+  slot = hash_name(name) & (name_table_size - 1);
+  while(name_table[slot] >= 0) {
+    if(strcmp(series[name_table[slot]].name, name) == 0) {
+      return name_table[slot];
+    }
+    slot = (slot + 1) & (name_table_size - 1);
+  }
+  if((n_series & (n_series - 1)) == 0) {
+    series = realloc(series, sizeof(series_t) * (n_series ? 2 * n_series : 1));
+  }
+  series[n_series].name = strdup(name);
+  series[n_series].n = 0;
+  name_table[slot] = n_series;
+  return n_series++;
+}
+
+/**
+ Reads series,x,y lines from a file, or from stdin if the path is "-", and
+ sorts the points so that those of each series are together. Returns the
+ number of points read, or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  char *line = NULL, *comma;
+  size_t line_size = 0;
+  double x, y, *sorted_x, *sorted_y;
+  int i, s, *fill;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  name_table = malloc(sizeof(int) * name_table_size);
+  memset(name_table, -1, sizeof(int) * name_table_size);
+  xs = malloc(sizeof(double) * capacity);
+  ys = malloc(sizeof(double) * capacity);
+  series_of = malloc(sizeof(int) * capacity);
+  while(getline(&line, &line_size, f) > 0) {
+    comma = strchr(line, ',');
+    if(comma == NULL || sscanf(comma + 1, " %lf , %lf", &x, &y) != 2) {
+      continue;
+    }
+    *comma = '\0';
+    if(n_data == capacity) {
+      capacity *= 2;
+      xs = realloc(xs, sizeof(double) * capacity);
+      ys = realloc(ys, sizeof(double) * capacity);
+      series_of = realloc(series_of, sizeof(int) * capacity);
+    }
+    s = find_series(line);
+    series[s].n++;
+    xs[n_data] = x;
+    ys[n_data] = y;
+    series_of[n_data++] = s;
+  }
+  free(line);
+  if(f != stdin) {
+    fclose(f);
+  }
+
+  fill = malloc(sizeof(int) * (n_series + 1));
+  for(s=0, i=0; s<n_series; s++) {
+    series[s].start = i;
+    fill[s] = i;
+    i += series[s].n;
+  }
+  sorted_x = malloc(sizeof(double) * (n_data > 0 ? n_data : 1));
+  sorted_y = malloc(sizeof(double) * (n_data > 0 ? n_data : 1));
+  for(i=0; i<n_data; i++) {
+    sorted_x[fill[series_of[i]]] = xs[i];
+    sorted_y[fill[series_of[i]]++] = ys[i];
+  }
+  free(xs);
+  free(ys);
+  free(series_of);
+  free(fill);
+  xs = sorted_x;
+  ys = sorted_y;
+  return n_data;
+}
+
+int longer_series(const void *a, const void *b) {
+  return series[*(int *) b].n - series[*(int *) a].n;
+}
+
+/**
+ Fits the LANES series in a group together, writing m, c and the error of
+ each into its series_t.
+*/
+
+void fit_group(int group, double *px, double *py) {
+  double sx[LANES] = {0}, sy[LANES] = {0};
+  double sxx[LANES] = {0}, sxy[LANES] = {0}, syy[LANES] = {0};
+  double x0[LANES], y0[LANES];
+  double n, dxx, dxy, dyy, residual;
+  int members[LANES];
+  int n_members = 0, length, i, j;
+  series_t *s;
+
+  for(j=0; j<LANES && group * LANES + j < n_series; j++) {
+    members[n_members++] = by_length[group * LANES + j];
+  }
+  length = series[by_length[group * LANES]].n;
+
+  memset(px, 0, sizeof(double) * LANES * length);
+  memset(py, 0, sizeof(double) * LANES * length);
+  for(j=0; j<n_members; j++) {
+    s = &series[members[j]];
+    x0[j] = xs[s->start];
+    y0[j] = ys[s->start];
+    for(i=0; i<s->n; i++) {
+      px[i * LANES + j] = xs[s->start + i] - x0[j];
+      py[i * LANES + j] = ys[s->start + i] - y0[j];
+    }
+  }
+
+  for(i=0; i<length; i++) {
+    for(j=0; j<LANES; j++) {
+      sx[j] += px[i * LANES + j];
+      sy[j] += py[i * LANES + j];
+      sxx[j] += px[i * LANES + j] * px[i * LANES + j];
+      sxy[j] += px[i * LANES + j] * py[i * LANES + j];
+      syy[j] += py[i * LANES + j] * py[i * LANES + j];
+    }
+  }
+
+  for(j=0; j<n_members; j++) {
+    s = &series[members[j]];
+    n = s->n;
+    dxx = sxx[j] - sx[j] * sx[j] / n;
+    dxy = sxy[j] - sx[j] * sy[j] / n;
+    dyy = syy[j] - sy[j] * sy[j] / n;
+    if(s->n < 2 || dxx <= 0) {
+      s->m = s->c = s->error = NAN;
+      continue;
+    }
+    s->m = dxy / dxx;
+    s->c = y0[j] + sy[j] / n - s->m * (x0[j] + sx[j] / n);
+    residual = dyy - s->m * dxy;
+    s->error = sqrt((residual > 0 ? residual : 0) / n);
+  }
+}
+
+void *worker(void *args) {
+  double *px, *py;
+  int longest = series[by_length[0]].n;
+  int group;
+
+  (void) args;
+  px = malloc(sizeof(double) * LANES * longest);
+  py = malloc(sizeof(double) * LANES * longest);
+  while(1) {
+    pthread_mutex_lock(&group_lock);
+    group = next_group++;
+    pthread_mutex_unlock(&group_lock);
+    if(group >= n_groups) {
+      break;
+    }
+    fit_group(group, px, py);
+  }
+  free(px);
+  free(py);
+  return NULL;
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  pthread_t threads[MAX_THREADS];
+  int n_threads = 1;
+  FILE *out = stdout;
+  int i;
+
+  if(argc < 2 || argc > 4) {
+    fprintf(stderr, "usage: %s series.csv [threads] [fits.csv]\n", argv[0]);
+    return 1;
+  }
+  if(argc >= 3) {
+    sscanf(argv[2], "%d", &n_threads);
+  }
+  if(n_threads < 1 || n_threads > MAX_THREADS) {
+    fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+    return 1;
+  }
+  if(argc == 4) {
+    out = fopen(argv[3], "w");
+    if(out == NULL) {
+      perror(argv[3]);
+      return 1;
+    }
+  }
+  if(load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  by_length = malloc(sizeof(int) * n_series);
+  for(i=0; i<n_series; i++) {
+    by_length[i] = i;
+  }
+  qsort(by_length, n_series, sizeof(int), longer_series);
+  n_groups = (n_series + LANES - 1) / LANES;
+
+  for(i=0; i<n_threads; i++) {
+    pthread_create(&threads[i], NULL, worker, NULL);
+  }
+  for(i=0; i<n_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+
+  for(i=0; i<n_series; i++) {
+    fprintf(out, "%s,%lf,%lf,%lf,%d\n", series[i].name, series[i].m,
+            series[i].c, series[i].error, series[i].n);
+  }
+  if(out != stdout) {
+    fclose(out);
+  }
+
+  time_difference(&start, &finish, &time_elapsed);
+  fprintf(stderr, "%d series of %d points fitted, %0.0lf fits/s\n", n_series,
+          n_data, n_series / (time_elapsed / 1.0e9));
+  fprintf(stderr, "Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+          (time_elapsed/1.0e9));
+  return 0;
+}
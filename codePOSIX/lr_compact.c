@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+/******************************************************************************
+ * This program performs the same 8 direction search as 118.c, but it can
+ * hold the points in less memory than a pair of doubles each. Once the data
+ * no longer fits in cache every rms_error() call is limited by how fast the
+ * points can be read, so reading fewer bytes per point makes it faster. The
+ * storage is chosen when the program runs:
+ *
+ *   double   16 bytes a point, as 118.c
+ *   float     8 bytes a point, x and y as single precision
+ *   fixed16   4 bytes a point, x and y as 16 bit integers in hundredths
+ *
+ * The points are held as two separate arrays, one of x and one of y, and
+ * whatever the storage, every value is widened to double as it is read and
+ * all the arithmetic and sums are in double precision, so only the rounding
+ * of the stored values differs.
+ *
+ * Error bounds. If each stored x is within dx of the true value and each y
+ * within dy, each residual mx + c - y is out by at most |m| dx + dy, and so,
+ * by the triangle inequality for the rms, is the rms error of any estimate:
+ *
+ *   |rms' - rms| <= |m| dx + dy
+ *
+ * float    rounds to 24 significant bits, so a value below 256 in size is
+ *          within 2^-17, about 7.6e-6, and the rms error of an estimate with
+ *          a slope of about 1 is within about 1.5e-5 of the exact one.
+ * fixed16  rounds to the nearest hundredth, so values within +/-327.67 are
+ *          within 0.005. Values written with two decimal places, as lr00
+ *          writes them, are held exactly, and the search then finds exactly
+ *          the same minimum as in double; the error reported may differ in
+ *          the last bits, as the residuals are formed in hundredths, as
+ *          100e = m (100x) + 100c - 100y, and scaled back at the end.
+ *
+ * The program reports the largest rounding of x and y it actually made, and
+ * the bound on the rms error at the minimum found.
+ *
+ * Widening costs a few instructions per point, so while the points fit in
+ * cache float and fixed16 are a little slower than double. The saving in
+ * memory traffic only pays once they do not, as with millions of points.
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00.
+ *
+ * To compile, letting the compiler use the widest vectors the processor has:
+ *   cc -O2 -march=native -o lr_compact lr_compact.c -lm
+ *
+ * To run with the points held as floats, or in fixed point:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_compact lr00_results.csv float
+ *   ./lr_compact lr00_results.csv fixed16
+ *****************************************************************************/
+
+#define STORE_DOUBLE 0
+#define STORE_FLOAT 1
+#define STORE_FIXED16 2
+#define FIXED_SCALE 100.0
+
+int n_data = 0;
+int storage = STORE_DOUBLE;
+
+double *xd, *yd;
+float *xf, *yf;
+int16_t *xq, *yq;
+
+/** The largest rounding made in storing any x and any y. */
+double round_x = 0, round_y = 0;
+
+/**
+ Reads x,y lines from a file, or from stdin if the path is "-", and stores
+ them as chosen. Returns the number of points read, or -1 if the file cannot
+ be read or a value is too large for fixed16.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  double x, y, sx, sy;
+  int i;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  xd = malloc(sizeof(double) * capacity);
+  yd = malloc(sizeof(double) * capacity);
+  while(fscanf(f, " %lf , %lf", &x, &y) == 2) {
+    if(n_data == capacity) {
+      capacity *= 2;
+      xd = realloc(xd, sizeof(double) * capacity);
+      yd = realloc(yd, sizeof(double) * capacity);
+    }
+    xd[n_data] = x;
+    yd[n_data] = y;
+    n_data++;
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+
+  if(storage == STORE_FLOAT) {
+    xf = malloc(sizeof(float) * capacity);
+    yf = malloc(sizeof(float) * capacity);
+  } else if(storage == STORE_FIXED16) {
+    xq = malloc(sizeof(int16_t) * capacity);
+    yq = malloc(sizeof(int16_t) * capacity);
+  }
+  for(i=0; i<n_data && storage != STORE_DOUBLE; i++) {
+    if(storage == STORE_FLOAT) {
+      xf[i] = xd[i];
+      yf[i] = yd[i];
+      sx = xf[i];
+      sy = yf[i];
+    } else {
+      if(fabs(xd[i]) * FIXED_SCALE > INT16_MAX ||
+         fabs(yd[i]) * FIXED_SCALE > INT16_MAX) {
+        fprintf(stderr, "point %d, %lf,%lf, is outside the range of "
+                "fixed16\n", i + 1, xd[i], yd[i]);
+        return -1;
+      }
+      xq[i] = lround(xd[i] * FIXED_SCALE);
+      yq[i] = lround(yd[i] * FIXED_SCALE);
+      sx = xq[i] / FIXED_SCALE;
+      sy = yq[i] / FIXED_SCALE;
+    }
+    if(fabs(sx - xd[i]) > round_x) {
+      round_x = fabs(sx - xd[i]);
+    }
+    if(fabs(sy - yd[i]) > round_y) {
+      round_y = fabs(sy - yd[i]);
+    }
+  }
+  if(storage != STORE_DOUBLE) {
+    free(xd);
+    free(yd);
+  }
+  return n_data;
+}
+
+/**
+ The kernels use the vector extensions of gcc and clang, 8 doubles to a
+ vector, so that the loops are vectorised without changing the order of the
+ sums. Each kernel widens 16 stored points at a time to doubles and keeps
+ two vector sums, and the points left over at the end are added one by one.
+ 16 bit integers are widened to 32 bits on the way, as there is no
+ instruction to convert them to doubles directly.
+*/
+
+typedef double v8d __attribute__((vector_size(64)));
+typedef float v8f __attribute__((vector_size(32)));
+typedef int32_t v8i __attribute__((vector_size(32)));
+typedef int16_t v8s __attribute__((vector_size(16)));
+
+#define WIDEN(v) __builtin_convertvector(v, v8d)
+#define WIDEN16(v) __builtin_convertvector(__builtin_convertvector(v, v8i), v8d)
+#define SPLAT(a) {a, a, a, a, a, a, a, a}
+
+/**
+ Sums the squared residuals of points start onwards one at a time, reading
+ them from the arrays of the storage in use.
+*/
+
+double residual_sum_tail(int start, double m, double c) {
+  double sum = 0, e;
+  int i;
+
+  for(i=start; i<n_data; i++) {
+    if(storage == STORE_FLOAT) {
+      e = (m * (double) xf[i]) + c - (double) yf[i];
+    } else if(storage == STORE_FIXED16) {
+      e = (m * xq[i]) + c - yq[i];
+    } else {
+      e = (m * xd[i]) + c - yd[i];
+    }
+    sum += e * e;
+  }
+  return sum;
+}
+
+double add_lanes(v8d *s) {
+  return (((*s)[0] + (*s)[1]) + ((*s)[2] + (*s)[3]))
+         + (((*s)[4] + (*s)[5]) + ((*s)[6] + (*s)[7]));
+}
+
+double residual_sum_double(double m, double c) {
+  v8d vm = SPLAT(m), vc = SPLAT(c);
+  v8d s0 = {0}, s1 = {0}, x0, x1, y0, y1, e0, e1;
+  int i;
+
+  for(i=0; i+16<=n_data; i+=16) {
+    memcpy(&x0, xd + i, sizeof(x0));
+    memcpy(&x1, xd + i + 8, sizeof(x1));
+    memcpy(&y0, yd + i, sizeof(y0));
+    memcpy(&y1, yd + i + 8, sizeof(y1));
+    e0 = (vm * x0) + vc - y0;
+    e1 = (vm * x1) + vc - y1;
+    s0 += e0 * e0;
+    s1 += e1 * e1;
+  }
+  s0 += s1;
+  return add_lanes(&s0) + residual_sum_tail(i, m, c);
+}
+
+double residual_sum_float(double m, double c) {
+  v8d vm = SPLAT(m), vc = SPLAT(c);
+  v8d s0 = {0}, s1 = {0}, e0, e1;
+  v8f x0, x1, y0, y1;
+  int i;
+
+  for(i=0; i+16<=n_data; i+=16) {
+    memcpy(&x0, xf + i, sizeof(x0));
+    memcpy(&x1, xf + i + 8, sizeof(x1));
+    memcpy(&y0, yf + i, sizeof(y0));
+    memcpy(&y1, yf + i + 8, sizeof(y1));
+    e0 = (vm * WIDEN(x0)) + vc - WIDEN(y0);
+    e1 = (vm * WIDEN(x1)) + vc - WIDEN(y1);
+    s0 += e0 * e0;
+    s1 += e1 * e1;
+  }
+  s0 += s1;
+  return add_lanes(&s0) + residual_sum_tail(i, m, c);
+}
+
+/**
+ Works in hundredths throughout, so the stored integers are used as they
+ are and the scale is only applied once, to the total.
+*/
+
+double residual_sum_fixed16(double m, double c) {
+  double c100 = c * FIXED_SCALE;
+  v8d vm = SPLAT(m), vc = SPLAT(c100);
+  v8d s0 = {0}, s1 = {0}, e0, e1;
+  v8s x0, x1, y0, y1;
+  int i;
+
+  for(i=0; i+16<=n_data; i+=16) {
+    memcpy(&x0, xq + i, sizeof(x0));
+    memcpy(&x1, xq + i + 8, sizeof(x1));
+    memcpy(&y0, yq + i, sizeof(y0));
+    memcpy(&y1, yq + i + 8, sizeof(y1));
+    e0 = (vm * WIDEN16(x0)) + vc - WIDEN16(y0);
+    e1 = (vm * WIDEN16(x1)) + vc - WIDEN16(y1);
+    s0 += e0 * e0;
+    s1 += e1 * e1;
+  }
+  s0 += s1;
+  return (add_lanes(&s0) + residual_sum_tail(i, m, c100))
+         / (FIXED_SCALE * FIXED_SCALE);
+}
+
+double rms_error(double m, double c) {
+  double error_sum;
+
+  if(storage == STORE_FLOAT) {
+    error_sum = residual_sum_float(m, c);
+  } else if(storage == STORE_FIXED16) {
+    error_sum = residual_sum_fixed16(m, c);
+  } else {
+    error_sum = residual_sum_double(m, c);
+  }
+  return sqrt(error_sum / n_data);
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  int i;
+  double bm = 1.3;
+  double bc = 10;
+  double be;
+  double dm[8];
+  double dc[8];
+  double e[8];
+  double step = 0.01;
+  double best_error = 999999999;
+  int best_error_i = 0;
+  int minimum_found = 0;
+  char *names[] = {"double", "float", "fixed16"};
+  int bytes[] = {16, 8, 4};
+
+  double om[] = {0,1,1, 1, 0,-1,-1,-1};
+  double oc[] = {1,1,0,-1,-1,-1, 0, 1};
+
+  if(argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: %s data.csv [double|float|fixed16]\n", argv[0]);
+    return 1;
+  }
+  if(argc == 3) {
+    for(storage=0; storage<3 && strcmp(argv[2], names[storage]) != 0;
+        storage++);
+    if(storage == 3) {
+      fprintf(stderr, "the storage must be double, float or fixed16\n");
+      return 1;
+    }
+  }
+  if(load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    return 1;
+  }
+  printf("points held as %s, %d bytes a point\n", names[storage],
+         bytes[storage]);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  be = rms_error(bm, bc);
+
+  while(!minimum_found) {
+    for(i=0;i<8;i++) {
+      dm[i] = bm + (om[i] * step);
+      dc[i] = bc + (oc[i] * step);
+    }
+
+    for(i=0;i<8;i++) {
+      e[i] = rms_error(dm[i], dc[i]);
+      if(e[i] < best_error) {
+        best_error = e[i];
+        best_error_i = i;
+      }
+    }
+
+    if(best_error < be) {
+      be = best_error;
+      bm = dm[best_error_i];
+      bc = dc[best_error_i];
+    } else {
+      minimum_found = 1;
+    }
+  }
+  printf("minimum m,c is %lf,%lf with error %lf\n", bm, bc, be);
+  printf("largest rounding of x %g and of y %g, error within %g\n", round_x,
+         round_y, fabs(bm) * round_x + round_y);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+/******************************************************************************
+ * This program performs the same 8 direction search as 118.c, but it does
+ * not work out the error of any estimate twice. The estimates the search can
+ * reach all lie on a lattice, (1.3 + i step, 10 + j step) for integers i and
+ * j, and after a move several of the new neighbours, and the old base, are
+ * estimates that were neighbours of the old base. 118.c passes over all the
+ * data again for each of them.
+ *
+ * Here the base is held as its lattice coordinates (i, j) and the errors
+ * worked out are kept in a small cache keyed by them. The cache is a hash
+ * table of CACHE_SIZE entries in which a new entry simply replaces whatever
+ * was in its slot, since only the estimates around the current base are ever
+ * asked for again. Each neighbour is looked up first and only passed over
+ * the data if it is missing. The number of hits and misses is reported; each
+ * miss is one pass over the data, where 118.c makes 8 an iteration.
+ *
+ * As m and c are worked out from the integer coordinates rather than by
+ * adding the step again and again, they can differ from those of 118.c in
+ * the last bits, but not in anything that is printed.
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00.
+ *
+ * To compile:
+ *   cc -O2 -o lr_memo lr_memo.c -lm
+ *
+ * To run:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_memo lr00_results.csv
+ *****************************************************************************/
+
+#define CACHE_SIZE 64
+
+typedef struct point_t {
+  double x;
+  double y;
+} point_t;
+
+/**
+ One cached error. A slot whose used flag is clear is empty.
+*/
+
+typedef struct cache_entry_t {
+  int64_t i;
+  int64_t j;
+  double error;
+  int used;
+} cache_entry_t;
+
+int n_data = 0;
+point_t *data;
+
+cache_entry_t cache[CACHE_SIZE];
+long cache_hits = 0;
+long cache_misses = 0;
+
+/**
+ Reads x,y lines from a file, or from stdin if the path is "-". Returns the
+ number of points read, or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  point_t p;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  data = malloc(sizeof(point_t) * capacity);
+  while(fscanf(f, " %lf , %lf", &p.x, &p.y) == 2) {
+    if(n_data == capacity) {
+      capacity *= 2;
+      data = realloc(data, sizeof(point_t) * capacity);
+    }
+    data[n_data++] = p;
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+  return n_data;
+}
+
+double residual_error(double x, double y, double m, double c) {
+  double e = (m * x) + c - y;
+  return e * e;
+}
+
+double rms_error(double m, double c) {
+  int i;
+  double mean;
+  double error_sum = 0;
+
+  for(i=0; i<n_data; i++) {
+    error_sum += residual_error(data[i].x, data[i].y, m, c);
+  }
+
+  mean = error_sum / n_data;
+
+  return sqrt(mean);
+}
+
+/**
+ Returns the rms error at lattice point (i, j), from the cache if it is
+ there, otherwise by a pass over the data at (m, c), which it is then cached
+ under.
+*/
+
+double lattice_error(int64_t i, int64_t j, double m, double c) {
+  uint64_t h = ((uint64_t) i * 0x9e3779b97f4a7c15ULL)
+               ^ ((uint64_t) j * 0xc2b2ae3d27d4eb4fULL);
+  cache_entry_t *slot = &cache[(h >> 32) % CACHE_SIZE];
+
+  if(slot->used && slot->i == i && slot->j == j) {
+    cache_hits++;
+    return slot->error;
+  }
+  cache_misses++;
+  slot->i = i;
+  slot->j = j;
+  slot->error = rms_error(m, c);
+  slot->used = 1;
+  return slot->error;
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  int k;
+  double m0 = 1.3;
+  double c0 = 10;
+  int64_t bi = 0;
+  int64_t bj = 0;
+  double be;
+  double dm[8];
+  double dc[8];
+  double e[8];
+  double step = 0.01;
+  double best_error = 999999999;
+  int best_error_i = 0;
+  int minimum_found = 0;
+  int iterations = 0;
+
+  int om[] = {0,1,1, 1, 0,-1,-1,-1};
+  int oc[] = {1,1,0,-1,-1,-1, 0, 1};
+
+  if(argc != 2) {
+    fprintf(stderr, "usage: %s data.csv\n", argv[0]);
+    return 1;
+  }
+  if(load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  be = lattice_error(bi, bj, m0, c0);
+
+  while(!minimum_found) {
+    for(k=0;k<8;k++) {
+      dm[k] = m0 + ((bi + om[k]) * step);
+      dc[k] = c0 + ((bj + oc[k]) * step);
+    }
+
+    for(k=0;k<8;k++) {
+      e[k] = lattice_error(bi + om[k], bj + oc[k], dm[k], dc[k]);
+      if(e[k] < best_error) {
+        best_error = e[k];
+        best_error_i = k;
+      }
+    }
+    iterations++;
+
+    printf("best m,c is %lf,%lf with error %lf in direction %d\n",
+      dm[best_error_i], dc[best_error_i], best_error, best_error_i);
+    if(best_error < be) {
+      be = best_error;
+      bi += om[best_error_i];
+      bj += oc[best_error_i];
+    } else {
+      minimum_found = 1;
+    }
+  }
+  printf("minimum m,c is %lf,%lf with error %lf\n", m0 + (bi * step),
+         c0 + (bj * step), be);
+  printf("%d iterations, %ld passes over the data and %ld cache hits, "
+         "where 118.c makes %d passes\n", iterations, cache_misses,
+         cache_hits, 8 * iterations + 1);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
@@ -0,0 +1,360 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+/******************************************************************************
+ * This program fits y = b0 + b1 x1 + ... + bk xk to data with any number of
+ * features, where 118.c fits y = mx + c to data with one. Instead of a
+ * search it solves the normal equations
+ *
+ *   (X^T X) b = X^T y
+ *
+ * where each row of X is a point with a 1 in front for the intercept. The
+ * points are read into one array, a row per point, and X^T X and X^T y are
+ * built together as the top left and right hand column of the Gram matrix
+ * of the rows [1 x1 ... xk y].
+ *
+ * The rows are taken ROW_BLOCK at a time. Each block is copied transposed
+ * into a small tile, so that a column of the block is contiguous, and every
+ * entry of the Gram matrix is then a dot product of two tile columns. The
+ * tile stays in cache while it is used for all of them, so each point is
+ * read from memory once however many features there are, and the dot
+ * products vectorise. The blocks are shared between threads, each of which
+ * sums into its own Gram matrix, and the matrices are added at the end.
+ *
+ * X^T X is symmetric and, unless one feature is a combination of the others,
+ * positive definite, so it is factored by Cholesky, L L^T, and b is found
+ * by a forward and a back substitution. The rms error of the fit is then
+ * found by a pass over the points, as rms_error() does in 118.c.
+ *
+ * The data is read from a file of comma separated lines, each holding the k
+ * features of a point followed by its y. k is taken from the first line. A
+ * file of x,y lines, such as the one written by lr00, is the case k = 1.
+ *
+ * To compile:
+ *   cc -O2 -o lr_multi lr_multi.c -lm -pthread
+ *
+ * To run on the lr00 data, and on a file of points with many features
+ * using 4 threads:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_multi lr00_results.csv
+ *   ./lr_multi features.csv 4
+ *****************************************************************************/
+
+#define MAX_THREADS 256
+#define MAX_FEATURES 256
+#define ROW_BLOCK 256
+
+typedef struct slice_t {
+  int start;
+  int end;
+  double *gram;
+  double error_sum;
+} slice_t;
+
+int n_data = 0;
+int n_features = 0;
+double *data;
+
+/** The width of the Gram matrix, for the 1, the features and y. */
+int width;
+double *gram;
+double *coefficients;
+
+/**
+ Reads lines of comma separated numbers from a file, or from stdin if the
+ path is "-", into data, a row of n_features + 1 values per point. Returns
+ the number of points read, or -1 if the file cannot be read, its lines
+ are not all the same length or they have more than MAX_FEATURES features.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  char *line = NULL, *p, *end;
+  size_t line_size = 0;
+  double row[MAX_FEATURES + 1];
+  int n, line_number = 0;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  while(getline(&line, &line_size, f) > 0) {
+    line_number++;
+    p = line;
+    n = 0;
+    while(n <= MAX_FEATURES) {
+      row[n] = strtod(p, &end);
+      if(end == p) {
+        break;
+      }
+      n++;
+      p = end + strspn(end, " \t");
+      if(*p != ',') {
+        break;
+      }
+      p++;
+    }
+    if(n > MAX_FEATURES && p[-1] == ',') {
+      fprintf(stderr, "line %d has more than %d features\n", line_number,
+              MAX_FEATURES);
+      n_data = -1;
+      break;
+    }
+    if(n == 0 && strspn(line, " \t\r\n") == strlen(line)) {
+      continue;
+    }
+    if(n_features == 0) {
+      if(n < 2) {
+        fprintf(stderr, "line %d needs at least one feature and a y\n",
+                line_number);
+        n_data = -1;
+        break;
+      }
+      n_features = n - 1;
+      data = malloc(sizeof(double) * (n_features + 1) * capacity);
+    }
+    if(n != n_features + 1) {
+      fprintf(stderr, "line %d has %d values, not %d\n", line_number, n,
+              n_features + 1);
+      n_data = -1;
+      break;
+    }
+    if(n_data == capacity) {
+      capacity *= 2;
+      data = realloc(data, sizeof(double) * (n_features + 1) * capacity);
+    }
+    memcpy(data + (long) n_data * n, row, sizeof(double) * n);
+    n_data++;
+  }
+  free(line);
+  if(f != stdin) {
+    fclose(f);
+  }
+  return n_data;
+}
+
+/**
+ Adds the upper triangle of the Gram matrix of rows start to end-1, each
+ with a 1 in front, to g, a block of rows at a time.
+*/
+
+void accumulate_gram(int start, int end, double *g) {
+  double *tile = malloc(sizeof(double) * width * ROW_BLOCK);
+  double *row, *a, *b, sum;
+  int block, rows, r, j, k;
+
+  for(block=start; block<end; block+=ROW_BLOCK) {
+    rows = end - block < ROW_BLOCK ? end - block : ROW_BLOCK;
+    for(r=0; r<rows; r++) {
+      row = data + (long) (block + r) * (n_features + 1);
+      tile[r] = 1;
+      for(j=1; j<width; j++) {
+        tile[j * ROW_BLOCK + r] = row[j - 1];
+      }
+    }
+    for(j=0; j<width; j++) {
+      a = tile + j * ROW_BLOCK;
+      for(k=j; k<width; k++) {
+        b = tile + k * ROW_BLOCK;
+        sum = 0;
+        for(r=0; r<rows; r++) {
+          sum += a[r] * b[r];
+        }
+        g[j * width + k] += sum;
+      }
+    }
+  }
+  free(tile);
+}
+
+void *slice_gram(void *args) {
+  slice_t *slice = args;
+
+  slice->gram = calloc(width * width, sizeof(double));
+  accumulate_gram(slice->start, slice->end, slice->gram);
+  return NULL;
+}
+
+double residual_error(double *row) {
+  double e = coefficients[0] - row[n_features];
+  int j;
+
+  for(j=0; j<n_features; j++) {
+    e += coefficients[j + 1] * row[j];
+  }
+  return e * e;
+}
+
+void *slice_error(void *args) {
+  slice_t *slice = args;
+  int i;
+
+  slice->error_sum = 0;
+  for(i=slice->start; i<slice->end; i++) {
+    slice->error_sum += residual_error(data + (long) i * (n_features + 1));
+  }
+  return NULL;
+}
+
+/**
+ Runs f on n_threads slices of the data, cut on block boundaries.
+*/
+
+void run_slices(void *(*f)(void *), slice_t *slices, int n_threads) {
+  pthread_t threads[MAX_THREADS];
+  int n_blocks = (n_data + ROW_BLOCK - 1) / ROW_BLOCK;
+  int i;
+
+  for(i=0; i<n_threads; i++) {
+    slices[i].start = (long long) n_blocks * i / n_threads * ROW_BLOCK;
+    slices[i].end = (long long) n_blocks * (i + 1) / n_threads * ROW_BLOCK;
+    if(slices[i].end > n_data) {
+      slices[i].end = n_data;
+    }
+    pthread_create(&threads[i], NULL, f, &slices[i]);
+  }
+  for(i=0; i<n_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+}
+
+void build_gram(int n_threads) {
+  slice_t slices[MAX_THREADS];
+  int i, j;
+
+  run_slices(slice_gram, slices, n_threads);
+  gram = calloc(width * width, sizeof(double));
+  for(i=0; i<n_threads; i++) {
+    for(j=0; j<width*width; j++) {
+      gram[j] += slices[i].gram[j];
+    }
+    free(slices[i].gram);
+  }
+}
+
+/**
+ Solves (X^T X) b = X^T y, reading both from the upper triangle of the Gram
+ matrix. X^T X is overwritten by its Cholesky factor, L^T in the upper
+ triangle. Returns 0, or -1 if X^T X is not positive definite.
+*/
+
+int solve(void) {
+  int p = n_features + 1;
+  double *u = gram, sum;
+  int i, j, k;
+
+  for(j=0; j<p; j++) {
+    sum = u[j * width + j];
+    for(k=0; k<j; k++) {
+      sum -= u[k * width + j] * u[k * width + j];
+    }
+    if(sum <= 0) {
+      return -1;
+    }
+    u[j * width + j] = sqrt(sum);
+    for(i=j+1; i<p; i++) {
+      sum = u[j * width + i];
+      for(k=0; k<j; k++) {
+        sum -= u[k * width + j] * u[k * width + i];
+      }
+      u[j * width + i] = sum / u[j * width + j];
+    }
+  }
+
+  coefficients = malloc(sizeof(double) * p);
+  for(i=0; i<p; i++) {
+    sum = u[i * width + p];
+    for(k=0; k<i; k++) {
+      sum -= u[k * width + i] * coefficients[k];
+    }
+    coefficients[i] = sum / u[i * width + i];
+  }
+  for(i=p-1; i>=0; i--) {
+    sum = coefficients[i];
+    for(k=i+1; k<p; k++) {
+      sum -= u[i * width + k] * coefficients[k];
+    }
+    coefficients[i] = sum / u[i * width + i];
+  }
+  return 0;
+}
+
+double rms_error(int n_threads) {
+  slice_t slices[MAX_THREADS];
+  double error_sum = 0;
+  int i;
+
+  run_slices(slice_error, slices, n_threads);
+  for(i=0; i<n_threads; i++) {
+    error_sum += slices[i].error_sum;
+  }
+  return sqrt(error_sum / n_data);
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  int n_threads = 1;
+  double error;
+  int j;
+
+  if(argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: %s data.csv [threads]\n", argv[0]);
+    return 1;
+  }
+  if(argc == 3) {
+    sscanf(argv[2], "%d", &n_threads);
+  }
+  if(n_threads < 1 || n_threads > MAX_THREADS) {
+    fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+    return 1;
+  }
+  if(load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    return 1;
+  }
+  width = n_features + 2;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  build_gram(n_threads);
+  if(solve() != 0) {
+    fprintf(stderr, "X^T X is singular, some features are linearly "
+            "dependent\n");
+    return 1;
+  }
+  error = rms_error(n_threads);
+
+  printf("%d points with %d features\n", n_data, n_features);
+  printf("intercept is %lf\n", coefficients[0]);
+  for(j=1; j<=n_features; j++) {
+    printf("coefficient %d is %lf\n", j, coefficients[j]);
+  }
+  printf("rms error is %lf\n", error);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
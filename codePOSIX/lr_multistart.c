@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+/******************************************************************************
+ * This program runs the 8 direction search of 118.c from many starting
+ * points at once instead of only from (1.3, 10), and reports the best
+ * minimum found. For the squared error every start leads to the same
+ * minimum, but for losses that are not convex, such as cauchy, a search can
+ * stop in a poor local minimum, and one start far from the data can take a
+ * very long time.
+ *
+ * The starts are laid out on a grid over the box from (M_MIN, C_MIN) to
+ * (M_MAX, C_MAX). The threads take starts from a shared counter and run
+ * their searches over the same read-only data.
+ *
+ * Every search moves over one shared lattice, (i step, j step) for integers
+ * i and j, and starts are moved to the nearest point of it. Unlike 118.c the
+ * best neighbour is chosen afresh every iteration, so where a search goes
+ * next depends only on where it is. Once a search reaches a base that
+ * another search has already been through, it would follow the same path
+ * from there and cannot find anything better, so it is cancelled. The bases
+ * are recorded in a hash table shared by all the threads, claimed with an
+ * atomic compare and swap so no lock is needed.
+ *
+ * The loss can be chosen as in lr_fused.c:
+ *   squared   e^2, the error reported is the rms error as in 118.c
+ *   absolute  |e|, the error reported is the mean absolute error
+ *   huber     e^2/2 near zero and linear beyond HUBER_DELTA
+ *   cauchy    log(1 + e^2), which gives little weight to outliers
+ * For the last two the error reported is the mean loss.
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00.
+ *
+ * To compile:
+ *   cc -O2 -o lr_multistart lr_multistart.c -lm -pthread
+ *
+ * To run 16 starts on 4 threads with the squared error and with cauchy:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_multistart lr00_results.csv 4 16
+ *   ./lr_multistart lr00_results.csv 4 16 cauchy
+ *****************************************************************************/
+
+#define MAX_THREADS 256
+#define MAX_STARTS 4096
+#define HUBER_DELTA 10.0
+#define M_MIN -2.0
+#define M_MAX 4.0
+#define C_MIN -20.0
+#define C_MAX 80.0
+#define VISITED_SIZE (1 << 20)
+#define EMPTY_KEY (1ULL << 63)
+
+typedef struct point_t {
+  double x;
+  double y;
+} point_t;
+
+/**
+ The outcome of the search from one start. joined is the search whose path
+ it ran into, or -1 if it ran to a minimum.
+*/
+
+typedef struct search_t {
+  double start_m;
+  double start_c;
+  double m;
+  double c;
+  double error;
+  int iterations;
+  int joined;
+} search_t;
+
+int n_data = 0;
+point_t *data;
+
+double (*loss)(double);
+int rms = 1;
+double step = 0.01;
+
+int n_starts = 16;
+search_t searches[MAX_STARTS];
+int next_start = 0;
+pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** The lattice points that have been a base, and the search that got there
+    first. */
+uint64_t *visited_keys;
+int *visited_owners;
+
+/**
+ Reads x,y lines from a file, or from stdin if the path is "-". Returns the
+ number of points read, or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  point_t p;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  data = malloc(sizeof(point_t) * capacity);
+  while(fscanf(f, " %lf , %lf", &p.x, &p.y) == 2) {
+    if(n_data == capacity) {
+      capacity *= 2;
+      data = realloc(data, sizeof(point_t) * capacity);
+    }
+    data[n_data++] = p;
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+  return n_data;
+}
+
+double squared_loss(double e) {
+  return e * e;
+}
+
+double absolute_loss(double e) {
+  return fabs(e);
+}
+
+double huber_loss(double e) {
+  double a = fabs(e);
+  return a <= HUBER_DELTA ? 0.5 * e * e : HUBER_DELTA * (a - 0.5 * HUBER_DELTA);
+}
+
+double cauchy_loss(double e) {
+  return log1p(e * e);
+}
+
+double mean_error(double m, double c) {
+  double error_sum = 0;
+  int i;
+
+  for(i=0; i<n_data; i++) {
+    error_sum += loss((m * data[i].x) + c - data[i].y);
+  }
+  error_sum /= n_data;
+  return rms ? sqrt(error_sum) : error_sum;
+}
+
+/**
+ Records that search owner has reached lattice point (i, j). Returns owner
+ if it is the first to get there, otherwise the search that was. If the
+ table is full the point is not recorded and owner is returned.
+*/
+
+int visit(int64_t i, int64_t j, int owner) {
+  uint64_t key = ((uint64_t) i << 32) ^ ((uint64_t) j & 0xffffffff);
+  uint64_t slot = (key * 0x9e3779b97f4a7c15ULL) >> 40;
+  uint64_t expected;
+  int probes, other;
+
+  for(probes=0; probes<VISITED_SIZE; probes++) {
+    slot &= VISITED_SIZE - 1;
+    expected = EMPTY_KEY;
+    if(__atomic_compare_exchange_n(&visited_keys[slot], &expected, key, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      __atomic_store_n(&visited_owners[slot], owner, __ATOMIC_RELEASE);
+      return owner;
+    }
+    if(expected == key) {
+      while((other = __atomic_load_n(&visited_owners[slot],
+                                     __ATOMIC_ACQUIRE)) < 0);
+      return other;
+    }
+    slot++;
+  }
+  return owner;
+}
+
+/**
+ Runs the search from one start to a minimum, or until it joins the path of
+ another search.
+*/
+
+void search(int s) {
+  search_t *r = &searches[s];
+  int64_t bi = llround(r->start_m / step);
+  int64_t bj = llround(r->start_c / step);
+  double be, e, best_error;
+  int best_error_k, k;
+
+  int om[] = {0,1,1, 1, 0,-1,-1,-1};
+  int oc[] = {1,1,0,-1,-1,-1, 0, 1};
+
+  r->iterations = 0;
+  r->joined = visit(bi, bj, s);
+  be = mean_error(bi * step, bj * step);
+  while(r->joined == s) {
+    best_error = be;
+    best_error_k = -1;
+    for(k=0;k<8;k++) {
+      e = mean_error((bi + om[k]) * step, (bj + oc[k]) * step);
+      if(e < best_error) {
+        best_error = e;
+        best_error_k = k;
+      }
+    }
+    r->iterations++;
+    if(best_error_k < 0) {
+      break;
+    }
+    be = best_error;
+    bi += om[best_error_k];
+    bj += oc[best_error_k];
+    r->joined = visit(bi, bj, s);
+  }
+  if(r->joined == s) {
+    r->joined = -1;
+  }
+  r->m = bi * step;
+  r->c = bj * step;
+  r->error = be;
+}
+
+void *worker(void *args) {
+  int s;
+
+  (void) args;
+  while(1) {
+    pthread_mutex_lock(&start_lock);
+    s = next_start++;
+    pthread_mutex_unlock(&start_lock);
+    if(s >= n_starts) {
+      break;
+    }
+    search(s);
+  }
+  return NULL;
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  pthread_t threads[MAX_THREADS];
+  int n_threads = 1;
+  int grid, best = -1, s, i;
+  search_t *r;
+
+  loss = squared_loss;
+  if(argc < 2 || argc > 5) {
+    fprintf(stderr, "usage: %s data.csv [threads] [starts] "
+            "[squared|absolute|huber|cauchy]\n", argv[0]);
+    return 1;
+  }
+  if(argc >= 3) {
+    sscanf(argv[2], "%d", &n_threads);
+  }
+  if(argc >= 4) {
+    sscanf(argv[3], "%d", &n_starts);
+  }
+  if(argc == 5) {
+    rms = 0;
+    if(strcmp(argv[4], "squared") == 0) {
+      rms = 1;
+    } else if(strcmp(argv[4], "absolute") == 0) {
+      loss = absolute_loss;
+    } else if(strcmp(argv[4], "huber") == 0) {
+      loss = huber_loss;
+    } else if(strcmp(argv[4], "cauchy") == 0) {
+      loss = cauchy_loss;
+    } else {
+      fprintf(stderr, "unknown loss %s\n", argv[4]);
+      return 1;
+    }
+  }
+  if(n_threads < 1 || n_threads > MAX_THREADS) {
+    fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+    return 1;
+  }
+  if(n_starts < 1 || n_starts > MAX_STARTS) {
+    fprintf(stderr, "starts must be between 1 and %d\n", MAX_STARTS);
+    return 1;
+  }
+  if(load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    return 1;
+  }
+
+  visited_keys = malloc(sizeof(uint64_t) * VISITED_SIZE);
+  visited_owners = malloc(sizeof(int) * VISITED_SIZE);
+  for(i=0; i<VISITED_SIZE; i++) {
+    visited_keys[i] = EMPTY_KEY;
+    visited_owners[i] = -1;
+  }
+
+  grid = (int) ceil(sqrt(n_starts));
+  for(s=0; s<n_starts; s++) {
+    searches[s].start_m = M_MIN + (M_MAX - M_MIN) * (s % grid + 0.5) / grid;
+    searches[s].start_c = C_MIN + (C_MAX - C_MIN) * (s / grid + 0.5) / grid;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for(i=0; i<n_threads; i++) {
+    pthread_create(&threads[i], NULL, worker, NULL);
+  }
+  for(i=0; i<n_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  for(s=0; s<n_starts; s++) {
+    r = &searches[s];
+    if(r->joined >= 0) {
+      printf("start %d from %lf,%lf joined search %d after %d iterations\n",
+             s, r->start_m, r->start_c, r->joined, r->iterations);
+    } else {
+      printf("start %d from %lf,%lf found %lf,%lf with error %lf after %d "
+             "iterations\n", s, r->start_m, r->start_c, r->m, r->c, r->error,
+             r->iterations);
+      if(best < 0 || r->error < searches[best].error) {
+        best = s;
+      }
+    }
+  }
+  printf("minimum m,c is %lf,%lf with error %lf from start %d\n",
+         searches[best].m, searches[best].c, searches[best].error, best);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/******************************************************************************
+ * This program finds m and c with Newton's method instead of the 8 direction
+ * search of 118.c. Where the search probes 8 neighbours to learn which way
+ * is down, one pass over the data gives the mean loss L, its gradient g and
+ * its 2x2 Hessian H exactly. For a residual r = mx + c - y with loss p(r),
+ *
+ *   g = mean of p'(r) (x, 1)
+ *   H = mean of p''(r) (x^2, x; x, 1)
+ *
+ * and all 6 sums are gathered together in a single fused pass. The Newton
+ * step d solves H d = -g. It is taken whole if that lowers the loss enough
+ * (Armijo), otherwise halved until it does, and every trial point is
+ * evaluated with the same fused pass, so when a step is accepted the
+ * derivatives for the next one are already known and a full step costs one
+ * pass. For the squared error the first step lands on the least squares
+ * solution and the method stops after 4 passes, against the 19000 or so
+ * evaluations 118.c makes.
+ *
+ * For losses that are not convex H need not be positive definite, and then
+ * it is shifted by a multiple of the identity, just enough that it is, so d
+ * is always a direction in which the loss falls.
+ *
+ * The loss can be chosen as in lr_fused.c, except absolute, which has no
+ * second derivative:
+ *   squared   e^2, the error reported is the rms error as in 118.c
+ *   huber     e^2/2 near zero and linear beyond HUBER_DELTA
+ *   cauchy    log(1 + e^2), which gives little weight to outliers
+ * For the last two the error reported is the mean loss.
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00.
+ *
+ * To compile:
+ *   cc -O2 -o lr_newton lr_newton.c -lm
+ *
+ * To run:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_newton lr00_results.csv
+ *   ./lr_newton lr00_results.csv cauchy
+ *****************************************************************************/
+
+#define HUBER_DELTA 10.0
+#define MAX_ITERATIONS 100
+#define TOLERANCE 1e-12
+#define ARMIJO 1e-4
+
+typedef struct point_t {
+  double x;
+  double y;
+} point_t;
+
+/**
+ The mean loss at an estimate and its first and second derivatives with
+ respect to m and c.
+*/
+
+typedef struct derivatives_t {
+  double loss;
+  double gm;
+  double gc;
+  double hmm;
+  double hmc;
+  double hcc;
+} derivatives_t;
+
+int n_data = 0;
+point_t *data;
+int passes = 0;
+
+/**
+ Reads x,y lines from a file, or from stdin if the path is "-". Returns the
+ number of points read, or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  point_t p;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  data = malloc(sizeof(point_t) * capacity);
+  while(fscanf(f, " %lf , %lf", &p.x, &p.y) == 2) {
+    if(n_data == capacity) {
+      capacity *= 2;
+      data = realloc(data, sizeof(point_t) * capacity);
+    }
+    data[n_data++] = p;
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+  return n_data;
+}
+
+/**
+ Each loss gives its value and its first and second derivatives at e.
+*/
+
+static inline void squared_loss(double e, double *p, double *d1, double *d2) {
+  *p = e * e;
+  *d1 = 2 * e;
+  *d2 = 2;
+}
+
+static inline void huber_loss(double e, double *p, double *d1, double *d2) {
+  double a = fabs(e);
+
+  if(a <= HUBER_DELTA) {
+    *p = 0.5 * e * e;
+    *d1 = e;
+    *d2 = 1;
+  } else {
+    *p = HUBER_DELTA * (a - 0.5 * HUBER_DELTA);
+    *d1 = e > 0 ? HUBER_DELTA : -HUBER_DELTA;
+    *d2 = 0;
+  }
+}
+
+static inline void cauchy_loss(double e, double *p, double *d1, double *d2) {
+  double q = 1 + e * e;
+
+  *p = log(q);
+  *d1 = 2 * e / q;
+  *d2 = 2 * (1 - e * e) / (q * q);
+}
+
+/**
+ One pass over the data gathering the mean loss at (m, c) and its
+ derivatives. It is inlined into a function per loss below so the loss is
+ not an indirect call in the inner loop.
+*/
+
+static inline void fused_pass(void (*loss)(double, double *, double *,
+                                           double *),
+                              double m, double c, derivatives_t *d) {
+  double sp = 0, s1 = 0, s1x = 0, s2 = 0, s2x = 0, s2xx = 0;
+  double x, p, d1, d2;
+  int i;
+
+  for(i=0; i<n_data; i++) {
+    x = data[i].x;
+    loss((m * x) + c - data[i].y, &p, &d1, &d2);
+    sp += p;
+    s1 += d1;
+    s1x += d1 * x;
+    s2 += d2;
+    s2x += d2 * x;
+    s2xx += d2 * x * x;
+  }
+  d->loss = sp / n_data;
+  d->gm = s1x / n_data;
+  d->gc = s1 / n_data;
+  d->hmm = s2xx / n_data;
+  d->hmc = s2x / n_data;
+  d->hcc = s2 / n_data;
+  passes++;
+}
+
+void squared_pass(double m, double c, derivatives_t *d) {
+  fused_pass(squared_loss, m, c, d);
+}
+
+void huber_pass(double m, double c, derivatives_t *d) {
+  fused_pass(huber_loss, m, c, d);
+}
+
+void cauchy_pass(double m, double c, derivatives_t *d) {
+  fused_pass(cauchy_loss, m, c, d);
+}
+
+/**
+ Solves H (dm, dc) = -g, first shifting H by a multiple of the identity if
+ it is not safely positive definite. The smallest eigenvalue allowed is
+ relative to the size of H, but never below one relative to the size of g,
+ so that where H vanishes, as it does for huber when every residual is
+ beyond HUBER_DELTA, d is a finite step down the gradient.
+*/
+
+void newton_direction(derivatives_t *d, double *dm, double *dc) {
+  double hmm = d->hmm, hmc = d->hmc, hcc = d->hcc;
+  double least = 1e-8 * (fabs(hmm) + fabs(hcc));
+  double least_g = 1e-8 * (1 + sqrt(d->gm * d->gm + d->gc * d->gc));
+  double smallest = 0.5 * (hmm + hcc)
+                    - sqrt(0.25 * (hmm - hcc) * (hmm - hcc) + hmc * hmc);
+  double shift, det;
+
+  if(least < least_g) {
+    least = least_g;
+  }
+  if(smallest < least) {
+    shift = least - smallest;
+    hmm += shift;
+    hcc += shift;
+  }
+  det = hmm * hcc - hmc * hmc;
+  if(!(det > 0) || !isfinite(det)) {
+    *dm = -d->gm / least;
+    *dc = -d->gc / least;
+    return;
+  }
+  *dm = -(hcc * d->gm - hmc * d->gc) / det;
+  *dc = -(hmm * d->gc - hmc * d->gm) / det;
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  double bm = 1.3;
+  double bc = 10;
+  double dm, dc, t, slope;
+  derivatives_t base, trial;
+  int iteration;
+  int moved = 0;
+  int rms = 1;
+  void (*pass)(double, double, derivatives_t *) = squared_pass;
+
+  if(argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: %s data.csv [squared|huber|cauchy]\n", argv[0]);
+    return 1;
+  }
+  if(argc == 3) {
+    rms = 0;
+    if(strcmp(argv[2], "squared") == 0) {
+      rms = 1;
+    } else if(strcmp(argv[2], "huber") == 0) {
+      pass = huber_pass;
+    } else if(strcmp(argv[2], "cauchy") == 0) {
+      pass = cauchy_pass;
+    } else {
+      fprintf(stderr, "unknown loss %s\n", argv[2]);
+      return 1;
+    }
+  }
+  if(load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  pass(bm, bc, &base);
+  for(iteration=1; iteration<=MAX_ITERATIONS; iteration++) {
+    newton_direction(&base, &dm, &dc);
+    slope = base.gm * dm + base.gc * dc;
+    for(t=1; t>TOLERANCE; t*=0.5) {
+      pass(bm + t * dm, bc + t * dc, &trial);
+      if(trial.loss <= base.loss + ARMIJO * t * slope) {
+        break;
+      }
+    }
+    if(t <= TOLERANCE || trial.loss >= base.loss) {
+      break;
+    }
+    bm += t * dm;
+    bc += t * dc;
+    base = trial;
+    moved = 1;
+    printf("m,c is %lf,%lf with error %lf after %d passes\n", bm, bc,
+           rms ? sqrt(base.loss) : base.loss, passes);
+    if(fabs(t * dm) <= TOLERANCE * (1 + fabs(bm)) &&
+       fabs(t * dc) <= TOLERANCE * (1 + fabs(bc))) {
+      break;
+    }
+  }
+  if(moved) {
+    printf("minimum m,c is %0.9lf,%0.9lf with error %0.9lf\n", bm, bc,
+           rms ? sqrt(base.loss) : base.loss);
+  } else {
+    printf("no progress from m,c %lf,%lf with error %lf\n", bm, bc,
+           rms ? sqrt(base.loss) : base.loss);
+  }
+  printf("%d passes over the data\n", passes);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
@@ -0,0 +1,537 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/******************************************************************************
+ * This program keeps a least squares line up to date as points arrive, one
+ * at a time or in batches, instead of fitting again from (1.3, 10) whenever
+ * the data changes as 118.c would have to. It holds the same sufficient
+ * statistics as lr_sums.c, the count, the means and the sums of products of
+ * deviations, and updates them in constant time for each point added
+ * (Welford) or removed (the same update run backwards). A batch of k points
+ * costs O(k): its own statistics are gathered in two passes and merged with
+ * the running ones (Chan et al.). The fit and its rms error follow from the
+ * statistics in constant time too:
+ *
+ *   m = Sxy / Sxx,  c = mean_y - m mean_x,  rms = sqrt((Syy - m Sxy) / n)
+ *
+ * With a window of w points, only the latest w count. Each new point beyond
+ * the first w pushes the oldest one out of a ring buffer and its removal is
+ * applied to the statistics; the oldest point can also be removed on its
+ * own. Removals let rounding errors build up, so a second set of statistics
+ * is kept alongside, of only the points written since slot 0 of the ring
+ * was last overwritten. It is only ever added to, and when the last slot is
+ * written with the window full it holds exactly the points in the window,
+ * so it replaces the running statistics. Rounding from removals is thereby
+ * discarded every w points at O(1) cost per point, with no pass over the
+ * window. An explicit removal spoils the second set until slot 0 comes
+ * round again.
+ *
+ * The points are read from a file of x,y lines, such as the one written by
+ * lr00, or from stdin if the file is "-", so the program can sit at the end
+ * of a pipe. They are added batch points at a time, 1 by default. The fit is
+ * printed every report points and after the last one.
+ *
+ * The check mode feeds a file through a window one point at a time, in
+ * batches of varying size and with explicit removals mixed in, and compares
+ * the statistics after every step with ones gathered afresh from the points
+ * that should be in the window.
+ *
+ * To compile:
+ *   cc -O2 -o lr_online lr_online.c -lm
+ *
+ * To fit all the lr00 data, to follow the fit over the latest 100 points,
+ * printing it every 50, and the same adding 25 points at a time:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_online lr00_results.csv
+ *   ./lr00 | ./lr_online - 100 50
+ *   ./lr00 | ./lr_online - 100 50 25
+ *
+ * To check the updates against direct sums with a window of 64:
+ *   ./lr_online check lr00_results.csv 64
+ *****************************************************************************/
+
+#define CHECK_TOLERANCE 1e-9
+
+typedef struct point_t {
+  double x;
+  double y;
+} point_t;
+
+/**
+ The sufficient statistics of a set of points.
+*/
+
+typedef struct moments_t {
+  long n;
+  double mean_x;
+  double mean_y;
+  double sxx;
+  double sxy;
+  double syy;
+} moments_t;
+
+/**
+ A regression that points can be added to and removed from. window is the
+ ring buffer of the points counted, of capacity points, with the oldest at
+ oldest. A capacity of 0 means that every point counts and none are kept.
+ fresh holds the points written since slot 0 was last overwritten, and is
+ only usable while fresh_valid is set.
+*/
+
+typedef struct online_t {
+  moments_t all;
+  moments_t fresh;
+  int fresh_valid;
+  point_t *window;
+  long capacity;
+  long oldest;
+} online_t;
+
+void online_init(online_t *r, long capacity) {
+  memset(r, 0, sizeof(*r));
+  r->capacity = capacity;
+  if(capacity > 0) {
+    r->window = malloc(sizeof(point_t) * capacity);
+  }
+}
+
+void moments_add(moments_t *s, double x, double y) {
+  double dx, dy;
+
+  s->n++;
+  dx = x - s->mean_x;
+  dy = y - s->mean_y;
+  s->mean_x += dx / s->n;
+  s->mean_y += dy / s->n;
+  s->sxx += dx * (x - s->mean_x);
+  s->sxy += dx * (y - s->mean_y);
+  s->syy += dy * (y - s->mean_y);
+}
+
+void moments_remove(moments_t *s, double x, double y) {
+  double mean_x = s->mean_x, mean_y = s->mean_y;
+
+  if(s->n == 1) {
+    memset(s, 0, sizeof(*s));
+    return;
+  }
+  s->n--;
+  s->mean_x = mean_x - (x - mean_x) / s->n;
+  s->mean_y = mean_y - (y - mean_y) / s->n;
+  s->sxx -= (x - s->mean_x) * (x - mean_x);
+  s->sxy -= (x - s->mean_x) * (y - mean_y);
+  s->syy -= (y - s->mean_y) * (y - mean_y);
+}
+
+/**
+ The statistics of count points, in two passes.
+*/
+
+moments_t moments_of(point_t *points, long count) {
+  moments_t s;
+  double sx = 0, sy = 0, dx, dy;
+  long i;
+
+  memset(&s, 0, sizeof(s));
+  if(count == 0) {
+    return s;
+  }
+  for(i=0; i<count; i++) {
+    sx += points[i].x;
+    sy += points[i].y;
+  }
+  s.n = count;
+  s.mean_x = sx / count;
+  s.mean_y = sy / count;
+  for(i=0; i<count; i++) {
+    dx = points[i].x - s.mean_x;
+    dy = points[i].y - s.mean_y;
+    s.sxx += dx * dx;
+    s.sxy += dx * dy;
+    s.syy += dy * dy;
+  }
+  return s;
+}
+
+/**
+ Adds the statistics of b, a set of points disjoint from those of a, to a
+ (Chan et al.).
+*/
+
+void moments_merge(moments_t *a, moments_t *b) {
+  double n, dx, dy;
+
+  if(b->n == 0) {
+    return;
+  }
+  if(a->n == 0) {
+    *a = *b;
+    return;
+  }
+  n = a->n + b->n;
+  dx = b->mean_x - a->mean_x;
+  dy = b->mean_y - a->mean_y;
+  a->sxx += b->sxx + dx * dx * a->n * b->n / n;
+  a->sxy += b->sxy + dx * dy * a->n * b->n / n;
+  a->syy += b->syy + dy * dy * a->n * b->n / n;
+  a->mean_x += dx * b->n / n;
+  a->mean_y += dy * b->n / n;
+  a->n += b->n;
+}
+
+/**
+ Takes the statistics of b, a subset of the points of a, out of a. It is
+ moments_merge() run backwards.
+*/
+
+void moments_unmerge(moments_t *a, moments_t *b) {
+  double n = a->n, rest = a->n - b->n, dx, dy;
+
+  if(b->n == 0) {
+    return;
+  }
+  if(rest <= 0) {
+    memset(a, 0, sizeof(*a));
+    return;
+  }
+  a->mean_x = (n * a->mean_x - b->n * b->mean_x) / rest;
+  a->mean_y = (n * a->mean_y - b->n * b->mean_y) / rest;
+  dx = b->mean_x - a->mean_x;
+  dy = b->mean_y - a->mean_y;
+  a->sxx -= b->sxx + dx * dx * rest * b->n / n;
+  a->sxy -= b->sxy + dx * dy * rest * b->n / n;
+  a->syy -= b->syy + dy * dy * rest * b->n / n;
+  a->n -= b->n;
+}
+
+/**
+ Called after slots up to last have been written. Once the last slot has
+ been written with the window full, fresh holds exactly the window and
+ replaces the running statistics.
+*/
+
+void online_wrapped(online_t *r, long last) {
+  if(last == r->capacity - 1 && r->all.n == r->capacity && r->fresh_valid) {
+    r->all = r->fresh;
+  }
+}
+
+/**
+ Adds a point, first removing the oldest one if the window is full.
+*/
+
+void online_add(online_t *r, double x, double y) {
+  long slot;
+
+  if(r->capacity == 0) {
+    moments_add(&r->all, x, y);
+    return;
+  }
+  slot = (r->oldest + r->all.n) % r->capacity;
+  if(slot == 0) {
+    memset(&r->fresh, 0, sizeof(r->fresh));
+    r->fresh_valid = 1;
+  }
+  if(r->all.n == r->capacity) {
+    moments_remove(&r->all, r->window[slot].x, r->window[slot].y);
+    r->oldest = (r->oldest + 1) % r->capacity;
+  }
+  r->window[slot].x = x;
+  r->window[slot].y = y;
+  moments_add(&r->all, x, y);
+  moments_add(&r->fresh, x, y);
+  online_wrapped(r, slot);
+}
+
+/**
+ Adds count points. Without a window their statistics are merged into the
+ running ones. With one they are written into the ring in runs that do not
+ wrap round, and for each run the statistics of the points it pushes out
+ are taken away and its own merged in.
+*/
+
+void online_add_batch(online_t *r, point_t *points, long count) {
+  moments_t batch, evicted;
+  long slot, run, n_evicted;
+
+  if(r->capacity == 0) {
+    batch = moments_of(points, count);
+    moments_merge(&r->all, &batch);
+    return;
+  }
+  if(count >= r->capacity) {
+    points += count - r->capacity;
+    memcpy(r->window, points, sizeof(point_t) * r->capacity);
+    r->all = moments_of(r->window, r->capacity);
+    r->fresh = r->all;
+    r->fresh_valid = 1;
+    r->oldest = 0;
+    return;
+  }
+  while(count > 0) {
+    slot = (r->oldest + r->all.n) % r->capacity;
+    run = r->capacity - slot < count ? r->capacity - slot : count;
+    if(slot == 0) {
+      memset(&r->fresh, 0, sizeof(r->fresh));
+      r->fresh_valid = 1;
+    }
+    n_evicted = r->all.n + run - r->capacity;
+    if(n_evicted > 0) {
+      evicted = moments_of(r->window + slot + run - n_evicted, n_evicted);
+      moments_unmerge(&r->all, &evicted);
+      r->oldest = (r->oldest + n_evicted) % r->capacity;
+    }
+    memcpy(r->window + slot, points, sizeof(point_t) * run);
+    batch = moments_of(points, run);
+    moments_merge(&r->all, &batch);
+    moments_merge(&r->fresh, &batch);
+    online_wrapped(r, slot + run - 1);
+    points += run;
+    count -= run;
+  }
+}
+
+/**
+ Removes the oldest point in the window, if there is one.
+*/
+
+void online_remove_oldest(online_t *r) {
+  if(r->capacity == 0 || r->all.n == 0) {
+    return;
+  }
+  moments_remove(&r->all, r->window[r->oldest].x, r->window[r->oldest].y);
+  r->oldest = (r->oldest + 1) % r->capacity;
+  r->fresh_valid = 0;
+}
+
+/**
+ The least squares line of a set of points, and its rms error. Returns 0, or
+ -1 if the slope is undefined because there are fewer than two distinct x
+ values.
+*/
+
+int moments_fit(moments_t *s, double *m, double *c, double *error) {
+  double residual;
+
+  if(s->n < 2 || s->sxx <= 0) {
+    return -1;
+  }
+  *m = s->sxy / s->sxx;
+  *c = s->mean_y - (*m * s->mean_x);
+  residual = s->syy - (*m * s->sxy);
+  *error = sqrt((residual > 0 ? residual : 0) / s->n);
+  return 0;
+}
+
+void print_fit(online_t *r, long seen) {
+  double m, c, error;
+
+  if(moments_fit(&r->all, &m, &c, &error) == 0) {
+    printf("after %ld points m,c is %lf,%lf with error %lf over %ld points\n",
+           seen, m, c, error, r->all.n);
+  } else {
+    printf("after %ld points there is no fit yet\n", seen);
+  }
+}
+
+/**
+ The largest difference between two sets of statistics, relative to the
+ size of the values.
+*/
+
+double moments_difference(moments_t *a, moments_t *b) {
+  double values[5][2] = {{a->mean_x, b->mean_x}, {a->mean_y, b->mean_y},
+                         {a->sxx, b->sxx}, {a->sxy, b->sxy},
+                         {a->syy, b->syy}};
+  double worst = a->n == b->n ? 0 : INFINITY, d;
+  int i;
+
+  for(i=0; i<5; i++) {
+    d = fabs(values[i][0] - values[i][1]) /
+        (1 + fabs(values[i][0]) + fabs(values[i][1]));
+    if(d > worst) {
+      worst = d;
+    }
+  }
+  return worst;
+}
+
+/**
+ Feeds the points through a window of w points one at a time, then in
+ batches of 1 to 37 points, removing the oldest point after every fifth
+ step, and compares the statistics after every step with ones gathered
+ afresh from the points that should be in the window, points lo to hi-1.
+ Returns the number of steps that differed by more than CHECK_TOLERANCE.
+*/
+
+int check(point_t *points, long n_points, long w) {
+  online_t r;
+  moments_t expected;
+  double d, worst = 0;
+  long next = 0, lo = 0, hi = 0, k, step;
+  int failures = 0;
+
+  online_init(&r, w);
+  for(step=0; next<n_points; step++) {
+    if(next < n_points / 2) {
+      online_add(&r, points[next].x, points[next].y);
+      k = 1;
+    } else {
+      k = 1 + step % 37;
+      if(k > n_points - next) {
+        k = n_points - next;
+      }
+      online_add_batch(&r, points + next, k);
+    }
+    next += k;
+    hi = next;
+    if(hi - lo > w) {
+      lo = hi - w;
+    }
+    if(step % 5 == 4 && hi > lo) {
+      online_remove_oldest(&r);
+      lo++;
+    }
+    expected = moments_of(points + lo, hi - lo);
+    d = moments_difference(&r.all, &expected);
+    if(d > worst) {
+      worst = d;
+    }
+    if(d > CHECK_TOLERANCE) {
+      failures++;
+    }
+  }
+  printf("%ld steps over %ld points with a window of %ld, largest relative "
+         "difference %g\n", step, n_points, w, worst);
+  printf("%s\n", failures == 0 ? "all checks passed" : "checks failed");
+  free(r.window);
+  return failures;
+}
+
+int run_check(char *path, long w) {
+  FILE *f = fopen(path, "r");
+  long n_points = 0, capacity = 1024;
+  point_t *points, p;
+  int failures;
+
+  if(f == NULL) {
+    perror(path);
+    return 1;
+  }
+  points = malloc(sizeof(point_t) * capacity);
+  while(fscanf(f, " %lf , %lf", &p.x, &p.y) == 2) {
+    if(n_points == capacity) {
+      capacity *= 2;
+      points = realloc(points, sizeof(point_t) * capacity);
+    }
+    points[n_points++] = p;
+  }
+  fclose(f);
+  failures = check(points, n_points, w);
+  free(points);
+  return failures == 0 ? 0 : 1;
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  online_t regression;
+  FILE *f = stdin;
+  long window = 0, report = 0, batch = 1, seen = 0, count = 0;
+  point_t *buffer;
+
+  if(argc >= 3 && argc <= 4 && strcmp(argv[1], "check") == 0) {
+    if(argc == 4) {
+      sscanf(argv[3], "%ld", &window);
+    } else {
+      window = 64;
+    }
+    if(window < 1) {
+      fprintf(stderr, "the window must be at least 1\n");
+      return 1;
+    }
+    return run_check(argv[2], window);
+  }
+  if(argc < 2 || argc > 5) {
+    fprintf(stderr, "usage: %s data.csv|- [window] [report every] [batch]\n"
+            "       %s check data.csv [window]\n", argv[0], argv[0]);
+    return 1;
+  }
+  if(argc >= 3) {
+    sscanf(argv[2], "%ld", &window);
+  }
+  if(argc >= 4) {
+    sscanf(argv[3], "%ld", &report);
+  }
+  if(argc == 5) {
+    sscanf(argv[4], "%ld", &batch);
+  }
+  if(window < 0 || report < 0 || batch < 1) {
+    fprintf(stderr, "the window and the report interval cannot be negative "
+            "and a batch is at least 1 point\n");
+    return 1;
+  }
+  if(strcmp(argv[1], "-") != 0) {
+    f = fopen(argv[1], "r");
+    if(f == NULL) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+  online_init(&regression, window);
+  buffer = malloc(sizeof(point_t) * batch);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while(1) {
+    for(count=0; count<batch; count++) {
+      if(fscanf(f, " %lf , %lf", &buffer[count].x, &buffer[count].y) != 2) {
+        break;
+      }
+    }
+    if(count == 0) {
+      break;
+    }
+    if(count == 1) {
+      online_add(&regression, buffer[0].x, buffer[0].y);
+    } else {
+      online_add_batch(&regression, buffer, count);
+    }
+    if(report > 0 && (seen + count) / report != seen / report) {
+      print_fit(&regression, seen + count);
+    }
+    seen += count;
+    if(count < batch) {
+      break;
+    }
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+  if(report == 0 || seen % report != 0) {
+    print_fit(&regression, seen);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  free(buffer);
+  return 0;
+}
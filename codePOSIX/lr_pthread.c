@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+/******************************************************************************
+ * This program performs the same 8 direction search as 118.c on a pool of
+ * threads. It replaces the approach of 118old.c, which created and joined a
+ * thread for every direction of every iteration, passed all of them the
+ * address of the same loop counter and let them race on best_error.
+ *
+ * Here the threads are created once and live for the whole search. Each
+ * iteration is a step between two barriers: the main thread publishes the 8
+ * estimates and waits at the first barrier, the workers evaluate them, and
+ * everyone meets at the second barrier. Workers only ever write their own
+ * results; after the second barrier the main thread combines them in a
+ * fixed order and chooses the next base, so there are no races.
+ *
+ * The work can be split two ways:
+ *   candidates  each thread evaluates some of the 8 estimates over all the
+ *               points, so at most 8 threads are useful
+ *   data        each thread evaluates all 8 estimates over a slice of the
+ *               points, and the partial sums are added together
+ *
+ * In data mode the answer does not depend on the number of threads, down to
+ * the last bit. The points are cut into blocks of BLOCK_SIZE, which do not
+ * depend on the thread count, and each thread takes a contiguous run of
+ * blocks. Within a block the sums are accumulated in order with Kahan
+ * compensation, and the block sums are then added in a fixed pairwise tree
+ * over the block numbers. The same additions happen in the same order
+ * however the blocks are shared out, so runs on any number of cores
+ * reproduce each other exactly.
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00.
+ *
+ * To compile:
+ *   cc -O2 -o lr_pthread lr_pthread.c -lm -pthread
+ *
+ * To run with 4 threads splitting the points:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_pthread lr00_results.csv 4 data
+ *****************************************************************************/
+
+#define MAX_THREADS 256
+#define BLOCK_SIZE 4096
+#define MODE_CANDIDATES 0
+#define MODE_DATA 1
+
+typedef struct point_t {
+  double x;
+  double y;
+} point_t;
+
+/**
+ One worker's private results, kept on their own cache line so that workers
+ do not slow each other down by writing to the same line.
+*/
+
+typedef struct worker_t {
+  double sums[8];
+  int index;
+} __attribute__((aligned(64))) worker_t;
+
+int n_data = 0;
+point_t *data;
+
+int n_threads = 1;
+int mode = MODE_DATA;
+worker_t workers[MAX_THREADS];
+pthread_barrier_t step_start, step_end;
+int search_finished = 0;
+
+double dm[8];
+double dc[8];
+
+int n_blocks = 0;
+double (*block_sums)[8];
+
+/**
+ Reads x,y lines from a file, or from stdin if the path is "-". Returns the
+ number of points read, or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  point_t p;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  data = malloc(sizeof(point_t) * capacity);
+  while(fscanf(f, " %lf , %lf", &p.x, &p.y) == 2) {
+    if(n_data == capacity) {
+      capacity *= 2;
+      data = realloc(data, sizeof(point_t) * capacity);
+    }
+    data[n_data++] = p;
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+  return n_data;
+}
+
+double residual_error(double x, double y, double m, double c) {
+  double e = (m * x) + c - y;
+  return e * e;
+}
+
+/**
+ Sums the squared residuals of estimates first to last-1 over points start
+ to end-1, into sums.
+*/
+
+void evaluate(int first, int last, int start, int end, double *sums) {
+  int i, j;
+
+  for(j=first; j<last; j++) {
+    sums[j] = 0;
+  }
+  for(i=start; i<end; i++) {
+    for(j=first; j<last; j++) {
+      sums[j] += residual_error(data[i].x, data[i].y, dm[j], dc[j]);
+    }
+  }
+}
+
+/**
+ Sums all 8 estimates over one block of points with Kahan compensation.
+*/
+
+void evaluate_block(int block, double *sums) {
+  double compensation[8], term, total;
+  int start = block * BLOCK_SIZE;
+  int end = start + BLOCK_SIZE < n_data ? start + BLOCK_SIZE : n_data;
+  int i, j;
+
+  for(j=0; j<8; j++) {
+    sums[j] = 0;
+    compensation[j] = 0;
+  }
+  for(i=start; i<end; i++) {
+    for(j=0; j<8; j++) {
+      term = residual_error(data[i].x, data[i].y, dm[j], dc[j])
+             - compensation[j];
+      total = sums[j] + term;
+      compensation[j] = (total - sums[j]) - term;
+      sums[j] = total;
+    }
+  }
+}
+
+/**
+ Adds the sums of blocks first to last-1 for estimate j by splitting the
+ range in half, so the order of the additions only depends on the blocks.
+*/
+
+double pairwise_sum(int first, int last, int j) {
+  int middle;
+
+  if(last - first == 1) {
+    return block_sums[first][j];
+  }
+  middle = first + (last - first) / 2;
+  return pairwise_sum(first, middle, j) + pairwise_sum(middle, last, j);
+}
+
+void *worker(void *args) {
+  worker_t *w = args;
+  int start, end, block;
+
+  while(1) {
+    pthread_barrier_wait(&step_start);
+    if(search_finished) {
+      break;
+    }
+    if(mode == MODE_DATA) {
+      start = (long long) n_blocks * w->index / n_threads;
+      end = (long long) n_blocks * (w->index + 1) / n_threads;
+      for(block=start; block<end; block++) {
+        evaluate_block(block, block_sums[block]);
+      }
+    } else if(w->index < 8) {
+      start = 8 * w->index / (n_threads < 8 ? n_threads : 8);
+      end = 8 * (w->index + 1) / (n_threads < 8 ? n_threads : 8);
+      evaluate(start, end, 0, n_data, w->sums);
+    }
+    pthread_barrier_wait(&step_end);
+  }
+  return NULL;
+}
+
+/**
+ Runs one step on the pool and leaves the rms error of each estimate in e.
+*/
+
+void evaluate_step(double *e) {
+  int n_used = n_threads < 8 ? n_threads : 8;
+  int i, j;
+
+  pthread_barrier_wait(&step_start);
+  pthread_barrier_wait(&step_end);
+
+  for(j=0; j<8; j++) {
+    e[j] = 0;
+  }
+  if(mode == MODE_DATA) {
+    for(j=0; j<8; j++) {
+      e[j] = pairwise_sum(0, n_blocks, j);
+    }
+  } else {
+    for(i=0; i<n_used; i++) {
+      for(j=8*i/n_used; j<8*(i+1)/n_used; j++) {
+        e[j] = workers[i].sums[j];
+      }
+    }
+  }
+  for(j=0; j<8; j++) {
+    e[j] = sqrt(e[j] / n_data);
+  }
+}
+
+double rms_error(double m, double c) {
+  int i;
+  double mean;
+  double error_sum = 0;
+
+  for(i=0; i<n_data; i++) {
+    error_sum += residual_error(data[i].x, data[i].y, m, c);
+  }
+
+  mean = error_sum / n_data;
+
+  return sqrt(mean);
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  pthread_t threads[MAX_THREADS];
+  int i;
+  double bm = 1.3;
+  double bc = 10;
+  double be;
+  double e[8];
+  double step = 0.01;
+  double best_error = 999999999;
+  int best_error_i = 0;
+  int minimum_found = 0;
+
+  double om[] = {0,1,1, 1, 0,-1,-1,-1};
+  double oc[] = {1,1,0,-1,-1,-1, 0, 1};
+
+  if(argc < 2 || argc > 4) {
+    fprintf(stderr, "usage: %s data.csv [threads] [candidates|data]\n",
+            argv[0]);
+    return 1;
+  }
+  if(argc >= 3) {
+    sscanf(argv[2], "%d", &n_threads);
+  }
+  if(n_threads < 1 || n_threads > MAX_THREADS) {
+    fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+    return 1;
+  }
+  if(argc == 4) {
+    if(strcmp(argv[3], "candidates") == 0) {
+      mode = MODE_CANDIDATES;
+    } else if(strcmp(argv[3], "data") != 0) {
+      fprintf(stderr, "the mode must be candidates or data\n");
+      return 1;
+    }
+  }
+  if(load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  n_blocks = (n_data + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  block_sums = malloc(sizeof(*block_sums) * n_blocks);
+
+  pthread_barrier_init(&step_start, NULL, n_threads + 1);
+  pthread_barrier_init(&step_end, NULL, n_threads + 1);
+  for(i=0; i<n_threads; i++) {
+    workers[i].index = i;
+    pthread_create(&threads[i], NULL, worker, &workers[i]);
+  }
+
+  be = rms_error(bm, bc);
+
+  while(!minimum_found) {
+    for(i=0;i<8;i++) {
+      dm[i] = bm + (om[i] * step);
+      dc[i] = bc + (oc[i] * step);
+    }
+
+    evaluate_step(e);
+    for(i=0;i<8;i++) {
+      if(e[i] < best_error) {
+        best_error = e[i];
+        best_error_i = i;
+      }
+    }
+
+    printf("best m,c is %lf,%lf with error %lf in direction %d\n",
+      dm[best_error_i], dc[best_error_i], best_error, best_error_i);
+    if(best_error < be) {
+      be = best_error;
+      bm = dm[best_error_i];
+      bc = dc[best_error_i];
+    } else {
+      minimum_found = 1;
+    }
+  }
+
+  search_finished = 1;
+  pthread_barrier_wait(&step_start);
+  for(i=0; i<n_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  pthread_barrier_destroy(&step_start);
+  pthread_barrier_destroy(&step_end);
+
+  printf("minimum m,c is %lf,%lf with error %lf\n", bm, bc, be);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
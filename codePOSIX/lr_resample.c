@@ -0,0 +1,396 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/******************************************************************************
+ * This program fits the least squares line as lr_sums.c does and then says
+ * how far it can be trusted, by k-fold cross validation and by a block
+ * bootstrap giving percentile confidence intervals for m and c.
+ *
+ * Resampling usually means fitting again to many subsets of the data. Here
+ * the data is only read once. It is cut into blocks of consecutive points
+ * and the sufficient statistics of every block, the count, the means and the
+ * sums of products of deviations, are gathered in parallel. Any union of
+ * blocks then has statistics that are merged from those of its blocks (Chan
+ * et al.), which give its least squares line and the rms error of any line
+ * over it without looking at the points again. A resample costs one merge
+ * per block rather than one visit per point, so thousands of them cost
+ * little more than the fit itself.
+ *
+ * Cross validation splits the blocks into k folds of consecutive blocks.
+ * Each fold in turn is held out, the line is fitted to the others, and its
+ * rms error over the held out fold is found. The mean of these errors
+ * estimates the error on new data.
+ *
+ * The bootstrap draws as many blocks as there are, with replacement, B
+ * times, and fits a line to each draw. Drawing whole blocks rather than
+ * single points keeps the dependence between neighbouring points, which
+ * telemetry usually has. The central part of the sorted slopes and
+ * intercepts gives the confidence intervals. Every resample draws its blocks
+ * from its own seed, so the intervals do not depend on the number of
+ * threads.
+ *
+ * Options:
+ *   -t threads      threads gathering statistics and resampling, 1
+ *   -k folds        folds for cross validation, 10
+ *   -b resamples    bootstrap resamples, 1000
+ *   -s points       points in a block, by default enough for BLOCKS blocks
+ *   -l level        confidence level of the intervals, 0.95
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00.
+ *
+ * To compile:
+ *   cc -O2 -o lr_resample lr_resample.c -lm -pthread
+ *
+ * To run with 4 threads and 10000 resamples:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_resample -t 4 -b 10000 lr00_results.csv
+ *****************************************************************************/
+
+#define MAX_THREADS 256
+#define BLOCKS 200
+#define SEED 118
+
+typedef struct point_t {
+  double x;
+  double y;
+} point_t;
+
+/**
+ The sufficient statistics of a set of points.
+*/
+
+typedef struct stats_t {
+  double n;
+  double mean_x;
+  double mean_y;
+  double sxx;
+  double sxy;
+  double syy;
+} stats_t;
+
+int n_data = 0;
+point_t *data;
+
+int n_threads = 1;
+int block_size = 0;
+int n_blocks;
+stats_t *blocks;
+
+int n_resamples = 1000;
+double *resample_m, *resample_c;
+
+/**
+ Reads x,y lines from a file, or from stdin if the path is "-". Returns the
+ number of points read, or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  point_t p;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  data = malloc(sizeof(point_t) * capacity);
+  while(fscanf(f, " %lf , %lf", &p.x, &p.y) == 2) {
+    if(n_data == capacity) {
+      capacity *= 2;
+      data = realloc(data, sizeof(point_t) * capacity);
+    }
+    data[n_data++] = p;
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+  return n_data;
+}
+
+/**
+ Combines the statistics of two disjoint sets of points (Chan et al.).
+*/
+
+stats_t merge_stats(stats_t a, stats_t b) {
+  stats_t r;
+  double dx, dy;
+
+  if(a.n == 0) {
+    return b;
+  }
+  if(b.n == 0) {
+    return a;
+  }
+  r.n = a.n + b.n;
+  dx = b.mean_x - a.mean_x;
+  dy = b.mean_y - a.mean_y;
+  r.mean_x = a.mean_x + dx * b.n / r.n;
+  r.mean_y = a.mean_y + dy * b.n / r.n;
+  r.sxx = a.sxx + b.sxx + dx * dx * a.n * b.n / r.n;
+  r.sxy = a.sxy + b.sxy + dx * dy * a.n * b.n / r.n;
+  r.syy = a.syy + b.syy + dy * dy * a.n * b.n / r.n;
+  return r;
+}
+
+/**
+ The statistics of one block, in two passes as it is in cache.
+*/
+
+stats_t block_stats(int block) {
+  int start = block * block_size;
+  int end = start + block_size < n_data ? start + block_size : n_data;
+  stats_t s;
+  double sx = 0, sy = 0, dx, dy;
+  int i;
+
+  for(i=start; i<end; i++) {
+    sx += data[i].x;
+    sy += data[i].y;
+  }
+  s.n = end - start;
+  s.mean_x = sx / s.n;
+  s.mean_y = sy / s.n;
+  s.sxx = s.sxy = s.syy = 0;
+  for(i=start; i<end; i++) {
+    dx = data[i].x - s.mean_x;
+    dy = data[i].y - s.mean_y;
+    s.sxx += dx * dx;
+    s.sxy += dx * dy;
+    s.syy += dy * dy;
+  }
+  return s;
+}
+
+/**
+ The least squares line of a set of points. Returns -1 if its slope is
+ undefined.
+*/
+
+int fit(stats_t *s, double *m, double *c) {
+  if(s->n < 2 || s->sxx <= 0) {
+    return -1;
+  }
+  *m = s->sxy / s->sxx;
+  *c = s->mean_y - (*m * s->mean_x);
+  return 0;
+}
+
+double rms_error(stats_t *s, double m, double c) {
+  double offset = (m * s->mean_x) + c - s->mean_y;
+  double error_sum = (m * m * s->sxx) - (2 * m * s->sxy) + s->syy
+                     + (s->n * offset * offset);
+
+  if(error_sum < 0) {
+    error_sum = 0;
+  }
+  return sqrt(error_sum / s->n);
+}
+
+void *gather_blocks(void *args) {
+  long t = (long) args;
+  int b;
+
+  for(b=(long long) n_blocks*t/n_threads; b<(long long) n_blocks*(t+1)/n_threads;
+      b++) {
+    blocks[b] = block_stats(b);
+  }
+  return NULL;
+}
+
+void *bootstrap(void *args) {
+  long t = (long) args;
+  unsigned int seed;
+  stats_t s;
+  int r, b;
+
+  for(r=(long long) n_resamples*t/n_threads;
+      r<(long long) n_resamples*(t+1)/n_threads; r++) {
+    seed = SEED + r;
+    s.n = 0;
+    for(b=0; b<n_blocks; b++) {
+      s = merge_stats(s, blocks[rand_r(&seed) % n_blocks]);
+    }
+    if(fit(&s, &resample_m[r], &resample_c[r]) != 0) {
+      resample_m[r] = resample_c[r] = NAN;
+    }
+  }
+  return NULL;
+}
+
+void run_threads(void *(*f)(void *)) {
+  pthread_t threads[MAX_THREADS];
+  long t;
+
+  for(t=0; t<n_threads; t++) {
+    pthread_create(&threads[t], NULL, f, (void *) t);
+  }
+  for(t=0; t<n_threads; t++) {
+    pthread_join(threads[t], NULL);
+  }
+}
+
+int compare_doubles(const void *a, const void *b) {
+  double x = *(double *) a, y = *(double *) b;
+  return (x > y) - (x < y);
+}
+
+/**
+ Sorts the n values and gives the interval holding the central fraction
+ level of them, and their standard deviation.
+*/
+
+void interval(double *values, int n, double level, double *low, double *high,
+              double *deviation) {
+  double mean = 0, sum = 0;
+  int i;
+
+  qsort(values, n, sizeof(double), compare_doubles);
+  *low = values[(int) floor((1 - level) / 2 * (n - 1))];
+  *high = values[(int) ceil((1 + level) / 2 * (n - 1))];
+  for(i=0; i<n; i++) {
+    mean += values[i];
+  }
+  mean /= n;
+  for(i=0; i<n; i++) {
+    sum += (values[i] - mean) * (values[i] - mean);
+  }
+  *deviation = n > 1 ? sqrt(sum / (n - 1)) : 0;
+}
+
+void usage(char *name) {
+  fprintf(stderr, "usage: %s [-t threads] [-k folds] [-b resamples] "
+          "[-s block size] [-l level] data.csv\n", name);
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  stats_t all, training, held_out;
+  double m, c, fold_m, fold_c, error, cv_sum = 0;
+  double level = 0.95, low, high, deviation;
+  int n_folds = 10, n_fitted, fold, first, last, b, r, opt;
+
+  while((opt = getopt(argc, argv, "t:k:b:s:l:")) != -1) {
+    switch(opt) {
+    case 't': n_threads = atoi(optarg); break;
+    case 'k': n_folds = atoi(optarg); break;
+    case 'b': n_resamples = atoi(optarg); break;
+    case 's': block_size = atoi(optarg); break;
+    case 'l': level = atof(optarg); break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if(optind != argc - 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  if(n_threads < 1 || n_threads > MAX_THREADS) {
+    fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+    return 1;
+  }
+  if(n_resamples < 1 || block_size < 0 || !(level > 0 && level < 1)) {
+    fprintf(stderr, "there must be a resample, and the level must be "
+            "between 0 and 1\n");
+    return 1;
+  }
+  if(load_data(argv[optind]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[optind]);
+    return 1;
+  }
+  if(block_size == 0) {
+    block_size = (n_data + BLOCKS - 1) / BLOCKS;
+  }
+  n_blocks = (n_data + block_size - 1) / block_size;
+  if(n_folds < 2 || n_folds > n_blocks) {
+    fprintf(stderr, "the folds must be between 2 and the %d blocks\n",
+            n_blocks);
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  blocks = malloc(sizeof(stats_t) * n_blocks);
+  run_threads(gather_blocks);
+  all.n = 0;
+  for(b=0; b<n_blocks; b++) {
+    all = merge_stats(all, blocks[b]);
+  }
+  if(fit(&all, &m, &c) != 0) {
+    fprintf(stderr, "every x is the same, the slope is undefined\n");
+    return 1;
+  }
+  printf("least squares m,c is %lf,%lf with error %lf\n", m, c,
+         rms_error(&all, m, c));
+  printf("%d blocks of %d points\n", n_blocks, block_size);
+
+  for(fold=0; fold<n_folds; fold++) {
+    first = (long long) n_blocks * fold / n_folds;
+    last = (long long) n_blocks * (fold + 1) / n_folds;
+    training.n = held_out.n = 0;
+    for(b=0; b<n_blocks; b++) {
+      if(b >= first && b < last) {
+        held_out = merge_stats(held_out, blocks[b]);
+      } else {
+        training = merge_stats(training, blocks[b]);
+      }
+    }
+    if(fit(&training, &fold_m, &fold_c) != 0) {
+      fprintf(stderr, "fold %d leaves too few points to fit\n", fold);
+      return 1;
+    }
+    error = rms_error(&held_out, fold_m, fold_c);
+    cv_sum += error;
+    printf("fold %d m,c is %lf,%lf with held out error %lf\n", fold, fold_m,
+           fold_c, error);
+  }
+  printf("%d-fold cross validation error %lf\n", n_folds, cv_sum / n_folds);
+
+  resample_m = malloc(sizeof(double) * n_resamples);
+  resample_c = malloc(sizeof(double) * n_resamples);
+  run_threads(bootstrap);
+  for(r=0, n_fitted=0; r<n_resamples; r++) {
+    if(!isnan(resample_m[r])) {
+      resample_m[n_fitted] = resample_m[r];
+      resample_c[n_fitted++] = resample_c[r];
+    }
+  }
+  if(n_fitted == 0) {
+    fprintf(stderr, "no resample could be fitted\n");
+    return 1;
+  }
+  interval(resample_m, n_fitted, level, &low, &high, &deviation);
+  printf("%g%% interval for m is %lf to %lf, standard error %lf\n",
+         level * 100, low, high, deviation);
+  interval(resample_c, n_fitted, level, &low, &high, &deviation);
+  printf("%g%% interval for c is %lf to %lf, standard error %lf\n",
+         level * 100, low, high, deviation);
+  printf("from %d bootstrap resamples\n", n_fitted);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
@@ -0,0 +1,410 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+/******************************************************************************
+ * This program fits a line that outliers cannot drag far, by minimising the
+ * Huber or the absolute (L1) loss of the residuals rather than their squares
+ * as residual_error() in 118.c does. A point 100 away from the line costs
+ * 10000 times as much as one 1 away under the squared error, so a few bad
+ * readings decide where the line goes; under these losses they cost only in
+ * proportion to their distance.
+ *
+ * It uses iteratively reweighted least squares. At the current line every
+ * point gets a weight from its residual r,
+ *
+ *   huber     1 if |r| <= HUBER_DELTA, otherwise HUBER_DELTA / |r|
+ *   absolute  1 / |r|, with |r| taken as no less than EPSILON
+ *
+ * and the next line is the weighted least squares line, which comes straight
+ * from the weighted sums of 1, x, y, x^2 and xy. Each step never increases
+ * the loss, and the lines converge to its minimum. The first pass gives every
+ * point a weight of 1, so the method starts from the ordinary least squares
+ * line. That pass is made at m = c = 0, where the loss it sums is the sum of
+ * y^2, and with the normal equations that gives the rms error of the least
+ * squares line without another pass.
+ *
+ * A pass works out the loss at the current line, the weights and the weighted
+ * sums together, so each step is a single pass over the data. The data is
+ * held as a structure of arrays, as in lr_simd.c, and the pass is written
+ * with GCC vector extensions, as in lr_compact.c, 8 points at a time with the
+ * choices made by masks rather than branches. The data is cut into one slice
+ * per thread and the sums of the slices are added when all are done.
+ *
+ * The points are centred on their means when they are read, which keeps the
+ * weighted sums well conditioned, and c is moved back when it is printed.
+ *
+ * The error reported for the least squares line is the rms error as in
+ * 118.c, and for the robust lines the mean loss, as in lr_fused.c.
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00.
+ *
+ * To compile, letting the compiler use the widest vectors the processor has:
+ *   cc -O2 -march=native -o lr_robust lr_robust.c -lm -pthread
+ *
+ * To run with the Huber loss, and with the absolute loss on 4 threads:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_robust lr00_results.csv
+ *   ./lr_robust lr00_results.csv absolute 4
+ *****************************************************************************/
+
+#define ALIGNMENT 64
+#define MAX_THREADS 256
+#define HUBER_DELTA 10.0
+#define EPSILON 1e-6
+#define MAX_ITERATIONS 500
+#define TOLERANCE 1e-9
+
+#define LOSS_SQUARED 0
+#define LOSS_HUBER 1
+#define LOSS_ABSOLUTE 2
+
+/**
+ The data set as a structure of arrays. x and y are aligned to a cache line.
+*/
+
+typedef struct dataset_t {
+  int n;
+  double *x;
+  double *y;
+} dataset_t;
+
+/**
+ The sum of the loss at a line and the weighted sums that give the next one.
+*/
+
+typedef struct sums_t {
+  double loss;
+  double w;
+  double wx;
+  double wy;
+  double wxx;
+  double wxy;
+} sums_t;
+
+typedef struct slice_t {
+  int start;
+  int end;
+  double m;
+  double c;
+  sums_t sums;
+} slice_t;
+
+dataset_t data;
+double mean_x = 0, mean_y = 0;
+int loss = LOSS_HUBER;
+
+/**
+ Reads x,y lines from a file, or from stdin if the path is "-", into aligned
+ arrays, centring them on their means. Returns the number of points read,
+ or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  double *x, *y, px, py;
+  int i;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  x = malloc(sizeof(double) * capacity);
+  y = malloc(sizeof(double) * capacity);
+  data.n = 0;
+  while(fscanf(f, " %lf , %lf", &px, &py) == 2) {
+    if(data.n == capacity) {
+      capacity *= 2;
+      x = realloc(x, sizeof(double) * capacity);
+      y = realloc(y, sizeof(double) * capacity);
+    }
+    x[data.n] = px;
+    y[data.n] = py;
+    mean_x += px;
+    mean_y += py;
+    data.n++;
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+  if(data.n == 0) {
+    return 0;
+  }
+
+  mean_x /= data.n;
+  mean_y /= data.n;
+  capacity = (data.n * sizeof(double) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  data.x = aligned_alloc(ALIGNMENT, capacity);
+  data.y = aligned_alloc(ALIGNMENT, capacity);
+  for(i=0; i<data.n; i++) {
+    data.x[i] = x[i] - mean_x;
+    data.y[i] = y[i] - mean_y;
+  }
+  free(x);
+  free(y);
+  return data.n;
+}
+
+/**
+ 8 doubles, and 8 masks the size of doubles. A comparison of two v8d gives
+ a v8l with all the bits of a lane set where it is true, and SELECT uses it
+ to choose each lane from a or b.
+*/
+
+typedef double v8d __attribute__((vector_size(64)));
+typedef int64_t v8l __attribute__((vector_size(64)));
+
+#define SPLAT(a) {a, a, a, a, a, a, a, a}
+#define SELECT(mask, a, b) \
+  ((v8d) (((mask) & (v8l) (a)) | (~(mask) & (v8l) (b))))
+
+double add_lanes(v8d *s) {
+  return (((*s)[0] + (*s)[1]) + ((*s)[2] + (*s)[3]))
+         + (((*s)[4] + (*s)[5]) + ((*s)[6] + (*s)[7]));
+}
+
+/**
+ The loss and weight of one residual, for the points left over after the
+ last full vector.
+*/
+
+static inline void weigh(int loss, double e, double *p, double *w) {
+  double a = fabs(e);
+
+  if(loss == LOSS_SQUARED) {
+    *p = e * e;
+    *w = 1;
+  } else if(loss == LOSS_HUBER) {
+    *p = a <= HUBER_DELTA ? 0.5 * e * e : HUBER_DELTA * (a - 0.5 * HUBER_DELTA);
+    *w = a <= HUBER_DELTA ? 1 : HUBER_DELTA / a;
+  } else {
+    *p = a;
+    *w = 1 / (a > EPSILON ? a : EPSILON);
+  }
+}
+
+/**
+ One pass over points start to end at the line (m, c), giving the sum of
+ the loss and the weighted sums. start must be a multiple of 8. It is
+ inlined into a function per loss below so the choice of loss is made
+ outside the loop.
+*/
+
+static inline void fused_pass(int loss, int start, int end, double m, double c,
+                              sums_t *s) {
+  const v8l abs_mask = SPLAT(INT64_MAX);
+  v8d vm = SPLAT(m), vc = SPLAT(c), delta = SPLAT(HUBER_DELTA);
+  v8d epsilon = SPLAT(EPSILON), half = SPLAT(0.5), one = SPLAT(1.0);
+  v8d sp = {0}, sw = {0}, swx = {0}, swy = {0}, swxx = {0}, swxy = {0};
+  v8d x, y, e, a, p, w, wx;
+  v8l outside;
+  double ps, ws;
+  int i;
+
+  for(i=start; i+8<=end; i+=8) {
+    memcpy(&x, data.x + i, sizeof(x));
+    memcpy(&y, data.y + i, sizeof(y));
+    e = (vm * x) + vc - y;
+    if(loss == LOSS_SQUARED) {
+      p = e * e;
+      w = one;
+    } else {
+      a = (v8d) ((v8l) e & abs_mask);
+      if(loss == LOSS_HUBER) {
+        outside = a > delta;
+        p = SELECT(outside, delta * (a - half * delta), half * e * e);
+        w = SELECT(outside, delta / a, one);
+      } else {
+        p = a;
+        w = one / SELECT(a > epsilon, a, epsilon);
+      }
+    }
+    wx = w * x;
+    sp += p;
+    sw += w;
+    swx += wx;
+    swy += w * y;
+    swxx += wx * x;
+    swxy += wx * y;
+  }
+  s->loss = add_lanes(&sp);
+  s->w = add_lanes(&sw);
+  s->wx = add_lanes(&swx);
+  s->wy = add_lanes(&swy);
+  s->wxx = add_lanes(&swxx);
+  s->wxy = add_lanes(&swxy);
+  for(; i<end; i++) {
+    weigh(loss, (m * data.x[i]) + c - data.y[i], &ps, &ws);
+    s->loss += ps;
+    s->w += ws;
+    s->wx += ws * data.x[i];
+    s->wy += ws * data.y[i];
+    s->wxx += ws * data.x[i] * data.x[i];
+    s->wxy += ws * data.x[i] * data.y[i];
+  }
+}
+
+void *squared_slice(void *args) {
+  slice_t *slice = args;
+  fused_pass(LOSS_SQUARED, slice->start, slice->end, slice->m, slice->c,
+             &slice->sums);
+  return NULL;
+}
+
+void *huber_slice(void *args) {
+  slice_t *slice = args;
+  fused_pass(LOSS_HUBER, slice->start, slice->end, slice->m, slice->c,
+             &slice->sums);
+  return NULL;
+}
+
+void *absolute_slice(void *args) {
+  slice_t *slice = args;
+  fused_pass(LOSS_ABSOLUTE, slice->start, slice->end, slice->m, slice->c,
+             &slice->sums);
+  return NULL;
+}
+
+/**
+ Runs a pass over all the data at (m, c) on n_threads slices, cut on
+ multiples of 8 points, and adds up their sums.
+*/
+
+void parallel_pass(void *(*f)(void *), int n_threads, double m, double c,
+                   sums_t *s) {
+  pthread_t threads[MAX_THREADS];
+  slice_t slices[MAX_THREADS];
+  int n_vectors = (data.n + 7) / 8;
+  int i;
+
+  for(i=0; i<n_threads; i++) {
+    slices[i].start = (long long) n_vectors * i / n_threads * 8;
+    slices[i].end = (long long) n_vectors * (i + 1) / n_threads * 8;
+    if(slices[i].end > data.n) {
+      slices[i].end = data.n;
+    }
+    slices[i].m = m;
+    slices[i].c = c;
+    pthread_create(&threads[i], NULL, f, &slices[i]);
+  }
+  memset(s, 0, sizeof(sums_t));
+  for(i=0; i<n_threads; i++) {
+    pthread_join(threads[i], NULL);
+    s->loss += slices[i].sums.loss;
+    s->w += slices[i].sums.w;
+    s->wx += slices[i].sums.wx;
+    s->wy += slices[i].sums.wy;
+    s->wxx += slices[i].sums.wxx;
+    s->wxy += slices[i].sums.wxy;
+  }
+}
+
+/**
+ The weighted least squares line from the weighted sums. Returns -1 if its
+ slope is undefined.
+*/
+
+int weighted_fit(sums_t *s, double *m, double *c) {
+  double det = (s->w * s->wxx) - (s->wx * s->wx);
+
+  if(!(det > 0)) {
+    return -1;
+  }
+  *m = ((s->w * s->wxy) - (s->wx * s->wy)) / det;
+  *c = (s->wy - (*m * s->wx)) / s->w;
+  return 0;
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  void *(*slice_pass)(void *) = huber_slice;
+  int n_threads = 1;
+  double m, c, next_m, next_c, error;
+  sums_t sums;
+  int passes = 0, iteration;
+
+  if(argc < 2 || argc > 4) {
+    fprintf(stderr, "usage: %s data.csv [huber|absolute] [threads]\n",
+            argv[0]);
+    return 1;
+  }
+  if(argc >= 3) {
+    if(strcmp(argv[2], "absolute") == 0) {
+      loss = LOSS_ABSOLUTE;
+      slice_pass = absolute_slice;
+    } else if(strcmp(argv[2], "huber") != 0) {
+      fprintf(stderr, "unknown loss %s\n", argv[2]);
+      return 1;
+    }
+  }
+  if(argc == 4) {
+    sscanf(argv[3], "%d", &n_threads);
+  }
+  if(n_threads < 1 || n_threads > MAX_THREADS) {
+    fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+    return 1;
+  }
+  if(load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  parallel_pass(squared_slice, n_threads, 0, 0, &sums);
+  passes++;
+  if(weighted_fit(&sums, &m, &c) != 0) {
+    fprintf(stderr, "every x is the same, the slope is undefined\n");
+    return 1;
+  }
+  error = (sums.loss - (m * sums.wxy) - (c * sums.wy)) / data.n;
+  printf("least squares m,c is %lf,%lf with error %lf\n", m,
+         c + mean_y - (m * mean_x), sqrt(error > 0 ? error : 0));
+  parallel_pass(slice_pass, n_threads, m, c, &sums);
+  passes++;
+  for(iteration=1; iteration<=MAX_ITERATIONS; iteration++) {
+    if(weighted_fit(&sums, &next_m, &next_c) != 0) {
+      break;
+    }
+    if(fabs(next_m - m) <= TOLERANCE * (1 + fabs(m)) &&
+       fabs(next_c - c) <= TOLERANCE * (1 + fabs(c))) {
+      break;
+    }
+    m = next_m;
+    c = next_c;
+    parallel_pass(slice_pass, n_threads, m, c, &sums);
+    passes++;
+    printf("m,c is %lf,%lf with error %lf after %d passes\n", m,
+           c + mean_y - (m * mean_x), sums.loss / data.n, passes);
+  }
+  printf("minimum m,c is %0.9lf,%0.9lf with error %0.9lf\n", m,
+         c + mean_y - (m * mean_x), sums.loss / data.n);
+  printf("%d passes over the data\n", passes);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
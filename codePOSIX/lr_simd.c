@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/******************************************************************************
+ * This program performs the same 8 direction search as 118.c with the data
+ * held as a structure of arrays: all the x values in one aligned array and
+ * all the y values in another, instead of an array of point_t. The sum of
+ * squared residuals is then computed with explicitly vectorised kernels that
+ * use fused multiply-add, 4 doubles at a time with AVX2 or 8 at a time with
+ * AVX-512. Which kernel is used is decided when the program runs, from what
+ * the processor supports, so the same binary runs everywhere.
+ *
+ * Each kernel keeps several independent accumulators so that consecutive
+ * FMAs do not wait on each other, which brings the loop close to the memory
+ * bandwidth once the data no longer fits in cache.
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00,
+ * or from a columnar file written by lr_convert. A columnar file is mapped
+ * into memory rather than read, and x and y point straight at its columns,
+ * so it is ready at once however large it is and nothing is copied.
+ *
+ * To compile:
+ *   cc -O2 -o lr_simd lr_simd.c -lm
+ *
+ * To run, letting the program choose the kernel or choosing it:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_simd lr00_results.csv
+ *   ./lr_simd lr00_results.csv scalar
+ *
+ * To run on the columnar form of the same data:
+ *   ./lr_convert lr00_results.csv lr00_results.lrc
+ *   ./lr_simd lr00_results.lrc
+ *****************************************************************************/
+
+#define ALIGNMENT 64
+#define LRC_MAGIC "LRCOLS1"
+#define LRC_FLOAT64 1
+
+/**
+ The data set as a structure of arrays. x and y are aligned to a cache line.
+*/
+
+typedef struct dataset_t {
+  int n;
+  double *x;
+  double *y;
+} dataset_t;
+
+/**
+ The header of a columnar file, as described in lr_convert.c.
+*/
+
+typedef struct lrc_header_t {
+  char magic[8];
+  uint64_t count;
+  uint32_t dtype;
+  uint32_t n_columns;
+  uint64_t offsets[2];
+  char reserved[24];
+} lrc_header_t;
+
+dataset_t data;
+
+double (*residual_sum)(double m, double c);
+
+/**
+ Maps a columnar file and points data at its columns. Returns the number of
+ points, 0 if the file is not a columnar file, or -1 if it is one but cannot
+ be used.
+*/
+
+int map_data(char *path) {
+  lrc_header_t header;
+  struct stat st;
+  char *base;
+  int fd = open(path, O_RDONLY);
+
+  if(fd < 0) {
+    return -1;
+  }
+  if(read(fd, &header, sizeof(header)) != sizeof(header) ||
+     memcmp(header.magic, LRC_MAGIC, sizeof(header.magic)) != 0) {
+    close(fd);
+    return 0;
+  }
+  if(header.dtype != LRC_FLOAT64 || header.n_columns != 2 ||
+     header.count > 0x7fffffff || fstat(fd, &st) != 0 ||
+     header.offsets[0] % ALIGNMENT != 0 || header.offsets[1] % ALIGNMENT != 0 ||
+     header.offsets[0] + header.count * sizeof(double) > (uint64_t) st.st_size ||
+     header.offsets[1] + header.count * sizeof(double) > (uint64_t) st.st_size) {
+    fprintf(stderr, "%s is not a usable columnar file\n", path);
+    close(fd);
+    return -1;
+  }
+  base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(base == MAP_FAILED) {
+    return -1;
+  }
+  madvise(base, st.st_size, MADV_SEQUENTIAL);
+  data.n = header.count;
+  data.x = (double *) (base + header.offsets[0]);
+  data.y = (double *) (base + header.offsets[1]);
+  return data.n;
+}
+
+/**
+ Reads x,y lines from a file, or from stdin if the path is "-", unless the
+ file is a columnar file, which is mapped instead. Returns the number of
+ points read, or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  double *x, *y, px, py;
+  int mapped;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    mapped = map_data(path);
+    if(mapped != 0) {
+      return mapped;
+    }
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  x = malloc(sizeof(double) * capacity);
+  y = malloc(sizeof(double) * capacity);
+  data.n = 0;
+  while(fscanf(f, " %lf , %lf", &px, &py) == 2) {
+    if(data.n == capacity) {
+      capacity *= 2;
+      x = realloc(x, sizeof(double) * capacity);
+      y = realloc(y, sizeof(double) * capacity);
+    }
+    x[data.n] = px;
+    y[data.n] = py;
+    data.n++;
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+
+  capacity = (data.n * sizeof(double) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  data.x = aligned_alloc(ALIGNMENT, capacity > 0 ? capacity : ALIGNMENT);
+  data.y = aligned_alloc(ALIGNMENT, capacity > 0 ? capacity : ALIGNMENT);
+  memcpy(data.x, x, sizeof(double) * data.n);
+  memcpy(data.y, y, sizeof(double) * data.n);
+  free(x);
+  free(y);
+  return data.n;
+}
+
+double residual_sum_scalar(double m, double c) {
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0, e;
+  int i;
+
+  for(i=0; i+4<=data.n; i+=4) {
+    e = (m * data.x[i]) + c - data.y[i];
+    s0 += e * e;
+    e = (m * data.x[i+1]) + c - data.y[i+1];
+    s1 += e * e;
+    e = (m * data.x[i+2]) + c - data.y[i+2];
+    s2 += e * e;
+    e = (m * data.x[i+3]) + c - data.y[i+3];
+    s3 += e * e;
+  }
+  for(; i<data.n; i++) {
+    e = (m * data.x[i]) + c - data.y[i];
+    s0 += e * e;
+  }
+  return (s0 + s1) + (s2 + s3);
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2,fma")))
+double residual_sum_avx2(double m, double c) {
+  __m256d vm = _mm256_set1_pd(m);
+  __m256d vc = _mm256_set1_pd(c);
+  __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+  __m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+  __m256d e0, e1, e2, e3;
+  double lanes[4], sum, e;
+  int i;
+
+  for(i=0; i+16<=data.n; i+=16) {
+    e0 = _mm256_fmadd_pd(vm, _mm256_load_pd(data.x + i), vc);
+    e1 = _mm256_fmadd_pd(vm, _mm256_load_pd(data.x + i + 4), vc);
+    e2 = _mm256_fmadd_pd(vm, _mm256_load_pd(data.x + i + 8), vc);
+    e3 = _mm256_fmadd_pd(vm, _mm256_load_pd(data.x + i + 12), vc);
+    e0 = _mm256_sub_pd(e0, _mm256_load_pd(data.y + i));
+    e1 = _mm256_sub_pd(e1, _mm256_load_pd(data.y + i + 4));
+    e2 = _mm256_sub_pd(e2, _mm256_load_pd(data.y + i + 8));
+    e3 = _mm256_sub_pd(e3, _mm256_load_pd(data.y + i + 12));
+    s0 = _mm256_fmadd_pd(e0, e0, s0);
+    s1 = _mm256_fmadd_pd(e1, e1, s1);
+    s2 = _mm256_fmadd_pd(e2, e2, s2);
+    s3 = _mm256_fmadd_pd(e3, e3, s3);
+  }
+  for(; i+4<=data.n; i+=4) {
+    e0 = _mm256_fmadd_pd(vm, _mm256_load_pd(data.x + i), vc);
+    e0 = _mm256_sub_pd(e0, _mm256_load_pd(data.y + i));
+    s0 = _mm256_fmadd_pd(e0, e0, s0);
+  }
+  s0 = _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3));
+  _mm256_storeu_pd(lanes, s0);
+  sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for(; i<data.n; i++) {
+    e = (m * data.x[i]) + c - data.y[i];
+    sum += e * e;
+  }
+  return sum;
+}
+
+__attribute__((target("avx512f")))
+double residual_sum_avx512(double m, double c) {
+  __m512d vm = _mm512_set1_pd(m);
+  __m512d vc = _mm512_set1_pd(c);
+  __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+  __m512d s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+  __m512d e0, e1, e2, e3;
+  double sum, e;
+  int i;
+
+  for(i=0; i+32<=data.n; i+=32) {
+    e0 = _mm512_fmadd_pd(vm, _mm512_load_pd(data.x + i), vc);
+    e0 = _mm512_sub_pd(e0, _mm512_load_pd(data.y + i));
+    e1 = _mm512_fmadd_pd(vm, _mm512_load_pd(data.x + i + 8), vc);
+    e1 = _mm512_sub_pd(e1, _mm512_load_pd(data.y + i + 8));
+    e2 = _mm512_fmadd_pd(vm, _mm512_load_pd(data.x + i + 16), vc);
+    e2 = _mm512_sub_pd(e2, _mm512_load_pd(data.y + i + 16));
+    e3 = _mm512_fmadd_pd(vm, _mm512_load_pd(data.x + i + 24), vc);
+    e3 = _mm512_sub_pd(e3, _mm512_load_pd(data.y + i + 24));
+    s0 = _mm512_fmadd_pd(e0, e0, s0);
+    s1 = _mm512_fmadd_pd(e1, e1, s1);
+    s2 = _mm512_fmadd_pd(e2, e2, s2);
+    s3 = _mm512_fmadd_pd(e3, e3, s3);
+  }
+  for(; i+8<=data.n; i+=8) {
+    e0 = _mm512_fmadd_pd(vm, _mm512_load_pd(data.x + i), vc);
+    e0 = _mm512_sub_pd(e0, _mm512_load_pd(data.y + i));
+    s0 = _mm512_fmadd_pd(e0, e0, s0);
+  }
+  s0 = _mm512_add_pd(_mm512_add_pd(s0, s1), _mm512_add_pd(s2, s3));
+  sum = _mm512_reduce_add_pd(s0);
+  for(; i<data.n; i++) {
+    e = (m * data.x[i]) + c - data.y[i];
+    sum += e * e;
+  }
+  return sum;
+}
+
+#endif
+
+/**
+ Chooses the kernel, by name if one is given, otherwise the widest one that
+ the processor supports. Returns the name of the kernel, or NULL if the one
+ asked for cannot be used.
+*/
+
+const char *select_kernel(char *name) {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if((name == NULL || strcmp(name, "avx512") == 0) &&
+     __builtin_cpu_supports("avx512f")) {
+    residual_sum = residual_sum_avx512;
+    return "avx512";
+  }
+  if((name == NULL || strcmp(name, "avx2") == 0) &&
+     __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    residual_sum = residual_sum_avx2;
+    return "avx2";
+  }
+#endif
+  if(name == NULL || strcmp(name, "scalar") == 0) {
+    residual_sum = residual_sum_scalar;
+    return "scalar";
+  }
+  return NULL;
+}
+
+double rms_error(double m, double c) {
+  return sqrt(residual_sum(m, c) / data.n);
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  const char *kernel;
+  int i;
+  double bm = 1.3;
+  double bc = 10;
+  double be;
+  double dm[8];
+  double dc[8];
+  double e[8];
+  double step = 0.01;
+  double best_error = 999999999;
+  int best_error_i = 0;
+  int minimum_found = 0;
+
+  double om[] = {0,1,1, 1, 0,-1,-1,-1};
+  double oc[] = {1,1,0,-1,-1,-1, 0, 1};
+
+  if(argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: %s data.csv [scalar|avx2|avx512]\n", argv[0]);
+    return 1;
+  }
+  kernel = select_kernel(argc == 3 ? argv[2] : NULL);
+  if(kernel == NULL) {
+    fprintf(stderr, "the %s kernel is not supported here\n", argv[2]);
+    return 1;
+  }
+  if(load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    return 1;
+  }
+  printf("using the %s kernel\n", kernel);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  be = rms_error(bm, bc);
+
+  while(!minimum_found) {
+    for(i=0;i<8;i++) {
+      dm[i] = bm + (om[i] * step);
+      dc[i] = bc + (oc[i] * step);
+    }
+
+    for(i=0;i<8;i++) {
+      e[i] = rms_error(dm[i], dc[i]);
+      if(e[i] < best_error) {
+        best_error = e[i];
+        best_error_i = i;
+      }
+    }
+
+    printf("best m,c is %lf,%lf with error %lf in direction %d\n",
+      dm[best_error_i], dc[best_error_i], best_error, best_error_i);
+    if(best_error < be) {
+      be = best_error;
+      bm = dm[best_error_i];
+      bc = dc[best_error_i];
+    } else {
+      minimum_found = 1;
+    }
+  }
+  printf("minimum m,c is %lf,%lf with error %lf\n", bm, bc, be);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
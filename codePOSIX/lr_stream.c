@@ -0,0 +1,412 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/******************************************************************************
+ * This program fits the same line as lr_sums.c to data that need not fit in
+ * memory. It streams a columnar file written by lr_convert in chunks, and
+ * only ever holds two chunks of it.
+ *
+ * A reader thread fills the two buffers in turn with pread() while the main
+ * thread reduces the other one, so the arithmetic on one chunk overlaps the
+ * read of the next. Each chunk is reduced to its sufficient statistics, the
+ * count, the means and the sums of products of deviations, which are merged
+ * into the running totals (Chan et al.). After the last chunk the statistics
+ * describe the whole file and, as in lr_sums.c, the search or the exact
+ * least squares solution needs no further pass over the data. The run time
+ * is then bounded by how fast the disk delivers the file.
+ *
+ * The chunk size is given in points, by default CHUNK_POINTS. Each chunk
+ * takes 16 bytes per point in each of the two buffers.
+ *
+ * To compile:
+ *   cc -O2 -o lr_stream lr_stream.c -lm -pthread
+ *
+ * To run on the lr00 data, searching or solving directly, and with chunks
+ * of 65536 points:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_convert lr00_results.csv lr00_results.lrc
+ *   ./lr_stream lr00_results.lrc
+ *   ./lr_stream lr00_results.lrc ols
+ *   ./lr_stream lr00_results.lrc ols 65536
+ *****************************************************************************/
+
+#define CHUNK_POINTS (1 << 20)
+#define LRC_MAGIC "LRCOLS1"
+#define LRC_FLOAT64 1
+
+/**
+ The header of a columnar file, as described in lr_convert.c.
+*/
+
+typedef struct lrc_header_t {
+  char magic[8];
+  uint64_t count;
+  uint32_t dtype;
+  uint32_t n_columns;
+  uint64_t offsets[2];
+  char reserved[24];
+} lrc_header_t;
+
+/**
+ The sufficient statistics of a set of points.
+*/
+
+typedef struct stats_t {
+  double n;
+  double mean_x;
+  double mean_y;
+  double sxx;
+  double sxy;
+  double syy;
+} stats_t;
+
+/**
+ One of the two buffers. full is set by the reader once count points have
+ been read into it, and cleared by the main thread once it has used them.
+ A count of 0 marks the end of the file, and -1 a failed read.
+*/
+
+typedef struct buffer_t {
+  double *x;
+  double *y;
+  long count;
+  int full;
+} buffer_t;
+
+int fd;
+lrc_header_t header;
+long chunk_points = CHUNK_POINTS;
+buffer_t buffers[2];
+pthread_mutex_t buffer_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t buffer_changed = PTHREAD_COND_INITIALIZER;
+stats_t stats;
+
+/**
+ Opens a columnar file and reads its header. Returns the number of points,
+ or -1 if the file cannot be used.
+*/
+
+long long open_data(char *path) {
+  struct stat st;
+
+  fd = open(path, O_RDONLY);
+  if(fd < 0) {
+    perror(path);
+    return -1;
+  }
+  if(read(fd, &header, sizeof(header)) != sizeof(header) ||
+     memcmp(header.magic, LRC_MAGIC, sizeof(header.magic)) != 0 ||
+     header.dtype != LRC_FLOAT64 || header.n_columns != 2 ||
+     fstat(fd, &st) != 0 ||
+     header.offsets[0] + header.count * sizeof(double) > (uint64_t) st.st_size ||
+     header.offsets[1] + header.count * sizeof(double) > (uint64_t) st.st_size) {
+    fprintf(stderr, "%s is not a columnar file, convert it with lr_convert\n",
+            path);
+    close(fd);
+    return -1;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  return header.count;
+}
+
+/**
+ Reads exactly bytes bytes at offset, retrying short reads. Returns 0 on
+ success.
+*/
+
+int read_fully(void *buffer, size_t bytes, off_t offset) {
+  char *p = buffer;
+  ssize_t r;
+
+  while(bytes > 0) {
+    r = pread(fd, p, bytes, offset);
+    if(r <= 0) {
+      return -1;
+    }
+    p += r;
+    bytes -= r;
+    offset += r;
+  }
+  return 0;
+}
+
+/**
+ The reader thread. Fills the buffers alternately, waiting whenever the
+ next one has not yet been used, and finishes with an empty buffer.
+*/
+
+void *reader(void *args) {
+  uint64_t next = 0;
+  long count;
+  int b = 0;
+  buffer_t *buffer;
+
+  (void) args;
+  while(1) {
+    buffer = &buffers[b];
+    pthread_mutex_lock(&buffer_lock);
+    while(buffer->full) {
+      pthread_cond_wait(&buffer_changed, &buffer_lock);
+    }
+    pthread_mutex_unlock(&buffer_lock);
+
+    count = header.count - next < (uint64_t) chunk_points ?
+            (long) (header.count - next) : chunk_points;
+    if(count > 0 &&
+       (read_fully(buffer->x, count * sizeof(double),
+                   header.offsets[0] + next * sizeof(double)) != 0 ||
+        read_fully(buffer->y, count * sizeof(double),
+                   header.offsets[1] + next * sizeof(double)) != 0)) {
+      count = -1;
+    }
+
+    pthread_mutex_lock(&buffer_lock);
+    buffer->count = count;
+    buffer->full = 1;
+    pthread_cond_broadcast(&buffer_changed);
+    pthread_mutex_unlock(&buffer_lock);
+
+    if(count <= 0) {
+      break;
+    }
+    next += count;
+    b = 1 - b;
+  }
+  return NULL;
+}
+
+/**
+ Combines the statistics of two disjoint sets of points (Chan et al.).
+*/
+
+stats_t merge_stats(stats_t a, stats_t b) {
+  stats_t r;
+  double dx, dy;
+
+  if(a.n == 0) {
+    return b;
+  }
+  if(b.n == 0) {
+    return a;
+  }
+  r.n = a.n + b.n;
+  dx = b.mean_x - a.mean_x;
+  dy = b.mean_y - a.mean_y;
+  r.mean_x = a.mean_x + dx * b.n / r.n;
+  r.mean_y = a.mean_y + dy * b.n / r.n;
+  r.sxx = a.sxx + b.sxx + dx * dx * a.n * b.n / r.n;
+  r.sxy = a.sxy + b.sxy + dx * dy * a.n * b.n / r.n;
+  r.syy = a.syy + b.syy + dy * dy * a.n * b.n / r.n;
+  return r;
+}
+
+/**
+ The statistics of one chunk. As the chunk is in memory they are found in
+ two passes, first the means and then the deviations from them, which
+ vectorise better than a point by point update.
+*/
+
+stats_t chunk_stats(double *x, double *y, long n) {
+  stats_t s;
+  double sx = 0, sy = 0, dx, dy;
+  long i;
+
+  for(i=0; i<n; i++) {
+    sx += x[i];
+    sy += y[i];
+  }
+  s.n = n;
+  s.mean_x = sx / n;
+  s.mean_y = sy / n;
+  s.sxx = s.sxy = s.syy = 0;
+  for(i=0; i<n; i++) {
+    dx = x[i] - s.mean_x;
+    dy = y[i] - s.mean_y;
+    s.sxx += dx * dx;
+    s.sxy += dx * dy;
+    s.syy += dy * dy;
+  }
+  return s;
+}
+
+/**
+ Streams the whole file through the buffers into stats. Returns 0 on
+ success.
+*/
+
+int gather_stats(void) {
+  pthread_t reader_thread;
+  buffer_t *buffer;
+  long count;
+  int b = 0;
+
+  stats.n = 0;
+  pthread_create(&reader_thread, NULL, reader, NULL);
+  while(1) {
+    buffer = &buffers[b];
+    pthread_mutex_lock(&buffer_lock);
+    while(!buffer->full) {
+      pthread_cond_wait(&buffer_changed, &buffer_lock);
+    }
+    count = buffer->count;
+    pthread_mutex_unlock(&buffer_lock);
+
+    if(count <= 0) {
+      break;
+    }
+    stats = merge_stats(stats, chunk_stats(buffer->x, buffer->y, count));
+
+    pthread_mutex_lock(&buffer_lock);
+    buffer->full = 0;
+    pthread_cond_broadcast(&buffer_changed);
+    pthread_mutex_unlock(&buffer_lock);
+    b = 1 - b;
+  }
+  pthread_join(reader_thread, NULL);
+  return count;
+}
+
+double rms_error(double m, double c) {
+  double offset = (m * stats.mean_x) + c - stats.mean_y;
+  double error_sum = (m * m * stats.sxx) - (2 * m * stats.sxy) + stats.syy
+                     + (stats.n * offset * offset);
+
+  if(error_sum < 0) {
+    error_sum = 0;
+  }
+  return sqrt(error_sum / stats.n);
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  int i;
+  double bm = 1.3;
+  double bc = 10;
+  double be;
+  double dm[8];
+  double dc[8];
+  double e[8];
+  double step = 0.01;
+  double best_error = 999999999;
+  int best_error_i = 0;
+  int minimum_found = 0;
+  int ols = 0;
+
+  double om[] = {0,1,1, 1, 0,-1,-1,-1};
+  double oc[] = {1,1,0,-1,-1,-1, 0, 1};
+
+  if(argc < 2 || argc > 4) {
+    fprintf(stderr, "usage: %s data.lrc [search|ols] [chunk points]\n",
+            argv[0]);
+    return 1;
+  }
+  if(argc >= 3) {
+    if(strcmp(argv[2], "ols") == 0) {
+      ols = 1;
+    } else if(strcmp(argv[2], "search") != 0) {
+      fprintf(stderr, "the solver must be search or ols\n");
+      return 1;
+    }
+  }
+  if(argc == 4) {
+    sscanf(argv[3], "%ld", &chunk_points);
+  }
+  if(chunk_points < 1) {
+    fprintf(stderr, "the chunk must hold at least one point\n");
+    return 1;
+  }
+  switch(open_data(argv[1])) {
+  case -1:
+    return 1;
+  case 0:
+    fprintf(stderr, "there are no points in %s\n", argv[1]);
+    return 1;
+  }
+  for(i=0; i<2; i++) {
+    buffers[i].x = malloc(sizeof(double) * chunk_points);
+    buffers[i].y = malloc(sizeof(double) * chunk_points);
+    buffers[i].full = 0;
+    if(buffers[i].x == NULL || buffers[i].y == NULL) {
+      fprintf(stderr, "could not allocate chunks of %ld points\n",
+              chunk_points);
+      return 1;
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if(gather_stats() != 0) {
+    fprintf(stderr, "reading %s failed\n", argv[1]);
+    return 1;
+  }
+  close(fd);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("%.0lf points streamed at %0.1lfMB/s\n", stats.n,
+         stats.n * 2 * sizeof(double) / (time_elapsed / 1.0e9) / 1.0e6);
+
+  if(ols) {
+    if(stats.sxx == 0) {
+      fprintf(stderr, "every x is the same, the slope is undefined\n");
+      return 1;
+    }
+    bm = stats.sxy / stats.sxx;
+    bc = stats.mean_y - (bm * stats.mean_x);
+    minimum_found = 1;
+  }
+
+  be = rms_error(bm, bc);
+
+  while(!minimum_found) {
+    for(i=0;i<8;i++) {
+      dm[i] = bm + (om[i] * step);
+      dc[i] = bc + (oc[i] * step);
+    }
+
+    for(i=0;i<8;i++) {
+      e[i] = rms_error(dm[i], dc[i]);
+      if(e[i] < best_error) {
+        best_error = e[i];
+        best_error_i = i;
+      }
+    }
+
+    if(best_error < be) {
+      be = best_error;
+      bm = dm[best_error_i];
+      bc = dc[best_error_i];
+    } else {
+      minimum_found = 1;
+    }
+  }
+  printf("minimum m,c is %lf,%lf with error %lf\n", bm, bc, be);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
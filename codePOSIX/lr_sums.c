@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+/******************************************************************************
+ * This program performs the same search as 118.c, stepping from an initial
+ * estimate of m and c in 8 directions until none of them improves on the
+ * base, but it does not loop over the data for every estimate.
+ *
+ * The squared error is a quadratic in m and c. Writing
+ *
+ *   mx + c - y = m(x - mean_x) - (y - mean_y) + (m mean_x + c - mean_y)
+ *
+ * the sum of squared residuals is
+ *
+ *   m^2 Sxx - 2m Sxy + Syy + n (m mean_x + c - mean_y)^2
+ *
+ * where Sxx, Sxy and Syy are sums of products of deviations from the means.
+ * These sufficient statistics carry the same information as the plain sums
+ * of x, y, x^2, xy and y^2, but do not lose precision by subtracting large,
+ * nearly equal numbers. They are gathered in a single pass over the data,
+ * split between threads, and every call to rms_error() afterwards costs the
+ * same however many points there are.
+ *
+ * The same statistics also give the exact least squares solution directly,
+ *
+ *   m = Sxy / Sxx,  c = mean_y - m mean_x
+ *
+ * so instead of the search the ols solver can be selected. Its answer is not
+ * limited to the 0.01 step of the search and its run time is one pass over
+ * the data.
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00.
+ *
+ * To compile:
+ *   cc -o lr_sums lr_sums.c -lm -pthread
+ *
+ * To run on the lr00 data with 4 threads, searching or solving directly:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_sums lr00_results.csv 4
+ *   ./lr_sums lr00_results.csv 4 ols
+ *****************************************************************************/
+
+#define MAX_THREADS 256
+
+typedef struct point_t {
+  double x;
+  double y;
+} point_t;
+
+/**
+ The sufficient statistics of a set of points.
+*/
+
+typedef struct stats_t {
+  double n;
+  double mean_x;
+  double mean_y;
+  double sxx;
+  double sxy;
+  double syy;
+} stats_t;
+
+typedef struct slice_t {
+  int start;
+  int end;
+  stats_t stats;
+} slice_t;
+
+int n_data = 0;
+point_t *data;
+stats_t stats;
+
+/**
+ Reads x,y lines from a file, or from stdin if the path is "-". Returns the
+ number of points read, or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  point_t p;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  data = malloc(sizeof(point_t) * capacity);
+  while(fscanf(f, " %lf , %lf", &p.x, &p.y) == 2) {
+    if(n_data == capacity) {
+      capacity *= 2;
+      data = realloc(data, sizeof(point_t) * capacity);
+    }
+    data[n_data++] = p;
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+  return n_data;
+}
+
+/**
+ Combines the statistics of two disjoint sets of points (Chan et al.).
+*/
+
+stats_t merge_stats(stats_t a, stats_t b) {
+  stats_t r;
+  double dx, dy;
+
+  if(a.n == 0) {
+    return b;
+  }
+  if(b.n == 0) {
+    return a;
+  }
+  r.n = a.n + b.n;
+  dx = b.mean_x - a.mean_x;
+  dy = b.mean_y - a.mean_y;
+  r.mean_x = a.mean_x + dx * b.n / r.n;
+  r.mean_y = a.mean_y + dy * b.n / r.n;
+  r.sxx = a.sxx + b.sxx + dx * dx * a.n * b.n / r.n;
+  r.sxy = a.sxy + b.sxy + dx * dy * a.n * b.n / r.n;
+  r.syy = a.syy + b.syy + dy * dy * a.n * b.n / r.n;
+  return r;
+}
+
+/**
+ Gathers the statistics of one slice of the data in a single streaming pass,
+ updating the means and the sums of products of deviations point by point
+ (Welford).
+*/
+
+void *slice_stats(void *args) {
+  slice_t *slice = args;
+  stats_t *s = &slice->stats;
+  double dx, dy;
+  int i;
+
+  s->n = s->mean_x = s->mean_y = s->sxx = s->sxy = s->syy = 0;
+  for(i=slice->start; i<slice->end; i++) {
+    s->n++;
+    dx = data[i].x - s->mean_x;
+    dy = data[i].y - s->mean_y;
+    s->mean_x += dx / s->n;
+    s->mean_y += dy / s->n;
+    s->sxx += dx * (data[i].x - s->mean_x);
+    s->sxy += dx * (data[i].y - s->mean_y);
+    s->syy += dy * (data[i].y - s->mean_y);
+  }
+  return NULL;
+}
+
+void gather_stats(int n_threads) {
+  pthread_t threads[MAX_THREADS];
+  slice_t slices[MAX_THREADS];
+  int i;
+
+  for(i=0; i<n_threads; i++) {
+    slices[i].start = (long long) n_data * i / n_threads;
+    slices[i].end = (long long) n_data * (i + 1) / n_threads;
+    pthread_create(&threads[i], NULL, slice_stats, &slices[i]);
+  }
+  stats.n = 0;
+  for(i=0; i<n_threads; i++) {
+    pthread_join(threads[i], NULL);
+    stats = merge_stats(stats, slices[i].stats);
+  }
+}
+
+double rms_error(double m, double c) {
+  double offset = (m * stats.mean_x) + c - stats.mean_y;
+  double error_sum = (m * m * stats.sxx) - (2 * m * stats.sxy) + stats.syy
+                     + (stats.n * offset * offset);
+
+  if(error_sum < 0) {
+    error_sum = 0;
+  }
+  return sqrt(error_sum / stats.n);
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  int i;
+  int n_threads = 1;
+  double bm = 1.3;
+  double bc = 10;
+  double be;
+  double dm[8];
+  double dc[8];
+  double e[8];
+  double step = 0.01;
+  double best_error = 999999999;
+  int best_error_i = 0;
+  int minimum_found = 0;
+  int ols = 0;
+
+  double om[] = {0,1,1, 1, 0,-1,-1,-1};
+  double oc[] = {1,1,0,-1,-1,-1, 0, 1};
+
+  if(argc < 2 || argc > 4) {
+    fprintf(stderr, "usage: %s data.csv [threads] [search|ols]\n", argv[0]);
+    return 1;
+  }
+  if(argc >= 3) {
+    sscanf(argv[2], "%d", &n_threads);
+  }
+  if(argc == 4) {
+    if(strcmp(argv[3], "ols") == 0) {
+      ols = 1;
+    } else if(strcmp(argv[3], "search") != 0) {
+      fprintf(stderr, "the solver must be search or ols\n");
+      return 1;
+    }
+  }
+  if(n_threads < 1 || n_threads > MAX_THREADS) {
+    fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+    return 1;
+  }
+  if(load_data(argv[1]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[1]);
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  gather_stats(n_threads);
+
+  if(ols) {
+    if(stats.sxx == 0) {
+      fprintf(stderr, "every x is the same, the slope is undefined\n");
+      return 1;
+    }
+    bm = stats.sxy / stats.sxx;
+    bc = stats.mean_y - (bm * stats.mean_x);
+    minimum_found = 1;
+  }
+
+  be = rms_error(bm, bc);
+
+  while(!minimum_found) {
+    for(i=0;i<8;i++) {
+      dm[i] = bm + (om[i] * step);
+      dc[i] = bc + (oc[i] * step);
+    }
+
+    for(i=0;i<8;i++) {
+      e[i] = rms_error(dm[i], dc[i]);
+      if(e[i] < best_error) {
+        best_error = e[i];
+        best_error_i = i;
+      }
+    }
+
+    printf("best m,c is %lf,%lf with error %lf in direction %d\n",
+      dm[best_error_i], dc[best_error_i], best_error, best_error_i);
+    if(best_error < be) {
+      be = best_error;
+      bm = dm[best_error_i];
+      bc = dc[best_error_i];
+    } else {
+      minimum_found = 1;
+    }
+  }
+  printf("minimum m,c is %lf,%lf with error %lf\n", bm, bc, be);
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}
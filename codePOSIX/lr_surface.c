@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/******************************************************************************
+ * This program works out the error of every estimate on a grid of m and c
+ * values, the whole error surface that the search of 118.c feels its way
+ * down, and writes it to a file to be plotted.
+ *
+ * Calling rms_error() for each grid point would read all the data once per
+ * point. Instead the grid is cut into tiles of TILE_ROWS values of m by all
+ * the values of c, and the data into blocks of BLOCK_SIZE points, small
+ * enough to stay in cache. Each block is read once per tile, and for each m
+ * in the tile the residuals u = mx - y of the block are found once and then
+ * used for every c, as the residual at (m, c) is u + c. The tiles are handed
+ * to the threads from a shared counter.
+ *
+ * For the squared error the data need not be visited per grid point at
+ * all. With the means and the sums of products of deviations from them,
+ * Sxx, Sxy and Syy, gathered in two passes as lr_sums.c does,
+ *
+ *   sum (mx + c - y)^2 = m^2 Sxx - 2m Sxy + Syy + n (m mean_x + c - mean_y)^2
+ *
+ * so the cost of a 1000 x 1000 grid over 10 million points is two passes
+ * and a million evaluations of this. Expanding around the means rather than
+ * zero keeps the terms from cancelling when c or y is large. The other
+ * losses, as in lr_fused.c, need the full tiled loop:
+ *   squared   e^2, the error written is the rms error as in 118.c
+ *   absolute  |e|, the error written is the mean absolute error
+ *   huber     e^2/2 near zero and linear beyond HUBER_DELTA
+ *   cauchy    log(1 + e^2), which gives little weight to outliers
+ * For the last two the error written is the mean loss.
+ *
+ * The grid is given as -m min,max,count and -c min,max,count, and by
+ * default covers the box searched by lr_multistart.c. If the output file
+ * name ends in .csv the surface is written as a heatmap, a first line of the
+ * c values and then a line per m value starting with it. Otherwise it is
+ * written as a binary matrix of doubles in the byte order of the machine, a
+ * row per m value, preceded by the two counts as 64 bit integers.
+ *
+ * The data is read from a file of x,y lines, such as the one written by lr00.
+ *
+ * To compile:
+ *   cc -O2 -o lr_surface lr_surface.c -lm -pthread
+ *
+ * To write the surface near the minimum on 4 threads as a heatmap, and the
+ * cauchy surface over the default box as a binary matrix:
+ *   ./lr00 > lr00_results.csv
+ *   ./lr_surface -t 4 -m 1,1.3,100 -c 30,40,100 lr00_results.csv surface.csv
+ *   ./lr_surface -l cauchy lr00_results.csv surface.bin
+ *****************************************************************************/
+
+#define MAX_THREADS 256
+#define TILE_ROWS 8
+#define BLOCK_SIZE 512
+#define HUBER_DELTA 10.0
+
+#define LOSS_SQUARED 0
+#define LOSS_ABSOLUTE 1
+#define LOSS_HUBER 2
+#define LOSS_CAUCHY 3
+
+/**
+ One axis of the grid, count values evenly spaced from min to max.
+*/
+
+typedef struct axis_t {
+  double min;
+  double max;
+  int count;
+} axis_t;
+
+int n_data = 0;
+double *xs, *ys;
+
+int loss = LOSS_SQUARED;
+axis_t m_axis = {-2, 4, 200};
+axis_t c_axis = {-20, 80, 200};
+double *surface;
+
+/** The statistics that give the squared error surface. */
+double mean_x, mean_y, sxx, sxy, syy;
+
+int n_tiles;
+int next_tile = 0;
+pthread_mutex_t tile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ Reads x,y lines from a file, or from stdin if the path is "-", into xs and
+ ys. Returns the number of points read, or -1 if the file cannot be read.
+*/
+
+int load_data(char *path) {
+  FILE *f = stdin;
+  int capacity = 1024;
+  double x, y;
+
+  if(path[0] != '-' || path[1] != '\0') {
+    f = fopen(path, "r");
+    if(f == NULL) {
+      return -1;
+    }
+  }
+  xs = malloc(sizeof(double) * capacity);
+  ys = malloc(sizeof(double) * capacity);
+  while(fscanf(f, " %lf , %lf", &x, &y) == 2) {
+    if(n_data == capacity) {
+      capacity *= 2;
+      xs = realloc(xs, sizeof(double) * capacity);
+      ys = realloc(ys, sizeof(double) * capacity);
+    }
+    xs[n_data] = x;
+    ys[n_data] = y;
+    n_data++;
+  }
+  if(f != stdin) {
+    fclose(f);
+  }
+  return n_data;
+}
+
+double axis_value(axis_t *a, int i) {
+  return a->count == 1 ? a->min
+         : a->min + (a->max - a->min) * i / (a->count - 1);
+}
+
+static inline double absolute_loss(double e) {
+  return fabs(e);
+}
+
+static inline double huber_loss(double e) {
+  double a = fabs(e);
+  return a <= HUBER_DELTA ? 0.5 * e * e : HUBER_DELTA * (a - 0.5 * HUBER_DELTA);
+}
+
+static inline double cauchy_loss(double e) {
+  return log1p(e * e);
+}
+
+/**
+ Adds the loss at (m, c) for every c of the grid over the residuals u of
+ one block to the sums of a row. It is inlined into a function per loss
+ below so the loss is not an indirect call in the inner loop.
+*/
+
+static inline void block_row(double (*f)(double), double *u, int n,
+                             double *row) {
+  double c, sum;
+  int j, k;
+
+  for(j=0; j<c_axis.count; j++) {
+    c = axis_value(&c_axis, j);
+    sum = 0;
+    for(k=0; k<n; k++) {
+      sum += f(u[k] + c);
+    }
+    row[j] += sum;
+  }
+}
+
+void absolute_row(double *u, int n, double *row) {
+  block_row(absolute_loss, u, n, row);
+}
+
+void huber_row(double *u, int n, double *row) {
+  block_row(huber_loss, u, n, row);
+}
+
+void cauchy_row(double *u, int n, double *row) {
+  block_row(cauchy_loss, u, n, row);
+}
+
+/**
+ Gathers the means of x and y and Sxx, Sxy and Syy, in two passes.
+*/
+
+void gather_moments(void) {
+  double sx = 0, sy = 0, dx, dy;
+  int i;
+
+  for(i=0; i<n_data; i++) {
+    sx += xs[i];
+    sy += ys[i];
+  }
+  mean_x = sx / n_data;
+  mean_y = sy / n_data;
+  sxx = sxy = syy = 0;
+  for(i=0; i<n_data; i++) {
+    dx = xs[i] - mean_x;
+    dy = ys[i] - mean_y;
+    sxx += dx * dx;
+    sxy += dx * dy;
+    syy += dy * dy;
+  }
+}
+
+/**
+ Works out the rows first to last-1 of the surface, for the squared error
+ from the statistics and otherwise a block of the data at a time.
+*/
+
+void surface_tile(int first, int last) {
+  double u[TILE_ROWS][BLOCK_SIZE];
+  double m, c, e, offset;
+  void (*row)(double *, int, double *) = absolute_row;
+  int start, n, i, j, k;
+
+  if(loss == LOSS_SQUARED) {
+    for(i=first; i<last; i++) {
+      m = axis_value(&m_axis, i);
+      for(j=0; j<c_axis.count; j++) {
+        c = axis_value(&c_axis, j);
+        offset = (m * mean_x) + c - mean_y;
+        e = (m * m * sxx) - (2 * m * sxy) + syy + (n_data * offset * offset);
+        surface[(long) i * c_axis.count + j] = sqrt((e > 0 ? e : 0) / n_data);
+      }
+    }
+    return;
+  }
+  if(loss == LOSS_HUBER) {
+    row = huber_row;
+  } else if(loss == LOSS_CAUCHY) {
+    row = cauchy_row;
+  }
+  for(i=first; i<last; i++) {
+    memset(surface + (long) i * c_axis.count, 0,
+           sizeof(double) * c_axis.count);
+  }
+
+  for(start=0; start<n_data; start+=BLOCK_SIZE) {
+    n = n_data - start < BLOCK_SIZE ? n_data - start : BLOCK_SIZE;
+    for(i=first; i<last; i++) {
+      m = axis_value(&m_axis, i);
+      for(k=0; k<n; k++) {
+        u[i - first][k] = (m * xs[start + k]) - ys[start + k];
+      }
+      row(u[i - first], n, surface + (long) i * c_axis.count);
+    }
+  }
+
+  for(i=first; i<last; i++) {
+    for(j=0; j<c_axis.count; j++) {
+      surface[(long) i * c_axis.count + j] /= n_data;
+    }
+  }
+}
+
+void *worker(void *args) {
+  int tile, last;
+
+  (void) args;
+  while(1) {
+    pthread_mutex_lock(&tile_lock);
+    tile = next_tile++;
+    pthread_mutex_unlock(&tile_lock);
+    if(tile >= n_tiles) {
+      break;
+    }
+    last = (tile + 1) * TILE_ROWS;
+    surface_tile(tile * TILE_ROWS, last < m_axis.count ? last : m_axis.count);
+  }
+  return NULL;
+}
+
+/**
+ Writes the surface as a heatmap if the path ends in .csv, otherwise as a
+ binary matrix. Returns 0 on success.
+*/
+
+int write_surface(char *path) {
+  FILE *f = fopen(path, "w");
+  size_t length = strlen(path);
+  long long counts[2] = {m_axis.count, c_axis.count};
+  int i, j;
+
+  if(f == NULL) {
+    return -1;
+  }
+  if(length >= 4 && strcmp(path + length - 4, ".csv") == 0) {
+    fprintf(f, "m\\c");
+    for(j=0; j<c_axis.count; j++) {
+      fprintf(f, ",%lf", axis_value(&c_axis, j));
+    }
+    fprintf(f, "\n");
+    for(i=0; i<m_axis.count; i++) {
+      fprintf(f, "%lf", axis_value(&m_axis, i));
+      for(j=0; j<c_axis.count; j++) {
+        fprintf(f, ",%lf", surface[(long) i * c_axis.count + j]);
+      }
+      fprintf(f, "\n");
+    }
+  } else {
+    fwrite(counts, sizeof(counts), 1, f);
+    fwrite(surface, sizeof(double), (long) m_axis.count * c_axis.count, f);
+  }
+  return fclose(f);
+}
+
+void usage(char *name) {
+  fprintf(stderr, "usage: %s [-t threads] [-l squared|absolute|huber|cauchy]\n"
+          "       [-m min,max,count] [-c min,max,count] data.csv "
+          "surface.csv|surface.bin\n", name);
+}
+
+int parse_axis(char *text, axis_t *a) {
+  return sscanf(text, "%lf,%lf,%d", &a->min, &a->max, &a->count) == 3 &&
+         a->count > 0 ? 0 : -1;
+}
+
+int time_difference(struct timespec *start, struct timespec *finish,
+                              long long int *difference) {
+  long long int ds =  finish->tv_sec - start->tv_sec;
+  long long int dn =  finish->tv_nsec - start->tv_nsec;
+
+  if(dn < 0 ) {
+    ds--;
+    dn += 1000000000;
+  }
+  *difference = ds * 1000000000 + dn;
+  return !(*difference > 0);
+}
+
+int main(int argc, char **argv) {
+  struct timespec start, finish;
+  long long int time_elapsed;
+  pthread_t threads[MAX_THREADS];
+  char *loss_names[] = {"squared", "absolute", "huber", "cauchy"};
+  int n_threads = 1;
+  long best = 0, i;
+  int opt;
+
+  while((opt = getopt(argc, argv, "t:l:m:c:")) != -1) {
+    switch(opt) {
+    case 't': n_threads = atoi(optarg); break;
+    case 'l':
+      for(loss=0; loss<4 && strcmp(optarg, loss_names[loss]) != 0; loss++);
+      if(loss == 4) {
+        fprintf(stderr, "unknown loss %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'm':
+      if(parse_axis(optarg, &m_axis) != 0) {
+        fprintf(stderr, "-m needs min,max,count\n");
+        return 1;
+      }
+      break;
+    case 'c':
+      if(parse_axis(optarg, &c_axis) != 0) {
+        fprintf(stderr, "-c needs min,max,count\n");
+        return 1;
+      }
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if(optind != argc - 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  if(n_threads < 1 || n_threads > MAX_THREADS) {
+    fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+    return 1;
+  }
+  if(load_data(argv[optind]) <= 0) {
+    fprintf(stderr, "no data could be read from %s\n", argv[optind]);
+    return 1;
+  }
+  surface = malloc(sizeof(double) * m_axis.count * c_axis.count);
+  if(surface == NULL) {
+    fprintf(stderr, "the grid is too large\n");
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if(loss == LOSS_SQUARED) {
+    gather_moments();
+  }
+  n_tiles = (m_axis.count + TILE_ROWS - 1) / TILE_ROWS;
+  for(i=0; i<n_threads; i++) {
+    pthread_create(&threads[i], NULL, worker, NULL);
+  }
+  for(i=0; i<n_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &finish);
+
+  for(i=1; i<(long) m_axis.count * c_axis.count; i++) {
+    if(surface[i] < surface[best]) {
+      best = i;
+    }
+  }
+  printf("%d x %d grid, lowest error %lf at m,c %lf,%lf\n", m_axis.count,
+         c_axis.count, surface[best], axis_value(&m_axis, best / c_axis.count),
+         axis_value(&c_axis, best % c_axis.count));
+  if(write_surface(argv[optind + 1]) != 0) {
+    perror(argv[optind + 1]);
+    return 1;
+  }
+
+  time_difference(&start, &finish, &time_elapsed);
+  printf("Time elapsed was %lldns or %0.9lfs\n", time_elapsed,
+         (time_elapsed/1.0e9));
+  return 0;
+}